@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+Runs the benchmark configs and reports wall time, peak RSS and throughput
+per scenario as JSON.
+
+	python3 run_bench.py --rbp ../bin/rbp --out bench_results.json [--compare old.json]
+"""
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+# name, config, unit of work, amount of work
+SCENARIOS = [
+	( "glob_loop",       "glob_loop.xml",       "plots",   1000 ),
+	( "range_loop",      "range_loop.xml",      "plots",   200 ),
+	( "multi_draw",      "multi_draw.xml",      "entries", 13 * 20000000 ),
+	( "export_1000",     "export_1000.xml",     "plots",   1000 ),
+	( "transform_chain", "transform_chain.xml", "plots",   2 ),
+]
+
+def make_data( args ):
+	if os.path.exists( "bench_hists.root" ) and os.path.exists( "bench_tree.lis" ) and not args.regen:
+		return
+	macro = "make_bench_data.C(%d, %d, %d)" % ( args.hists, args.entries, args.files )
+	print( "Generating benchmark data: %s" % macro )
+	subprocess.check_call( [ "root", "-l", "-b", "-q", macro ] )
+
+def run( args, name, cfg, unit, amount ):
+	cmd = [ args.rbp, cfg ]
+	log = open( os.path.join( "out", name + ".log" ), "w" )
+	start = time.time()
+	p = subprocess.Popen( cmd, stdout=log, stderr=subprocess.STDOUT )
+	_, status, usage = os.wait4( p.pid, 0 )
+	wall = time.time() - start
+	log.close()
+	# ru_maxrss is in kB on linux, bytes on macOS
+	rss = usage.ru_maxrss if sys.platform.startswith( "linux" ) else usage.ru_maxrss // 1024
+	return {
+		"name"        : name,
+		"config"      : cfg,
+		"status"      : os.WEXITSTATUS( status ) if os.WIFEXITED( status ) else -1,
+		"wall_s"      : round( wall, 3 ),
+		"user_s"      : round( usage.ru_utime, 3 ),
+		"sys_s"       : round( usage.ru_stime, 3 ),
+		"peak_rss_kb" : rss,
+		"unit"        : unit,
+		"amount"      : amount,
+		"throughput"  : round( amount / wall, 3 ) if wall > 0 else 0,
+	}
+
+def compare( results, old_url, tolerance ):
+	with open( old_url ) as f:
+		old = { s[ "name" ] : s for s in json.load( f )[ "scenarios" ] }
+	worse = False
+	for s in results:
+		if s[ "name" ] not in old:
+			continue
+		o = old[ s[ "name" ] ]
+		dt = ( s[ "wall_s" ] - o[ "wall_s" ] ) / max( o[ "wall_s" ], 1e-9 )
+		dm = ( s[ "peak_rss_kb" ] - o[ "peak_rss_kb" ] ) / float( max( o[ "peak_rss_kb" ], 1 ) )
+		flag = ""
+		if dt > tolerance or dm > tolerance:
+			flag = "  <-- REGRESSION"
+			worse = True
+		print( "%-16s time %+7.1f%%   rss %+7.1f%%%s" % ( s[ "name" ], 100 * dt, 100 * dm, flag ) )
+	return worse
+
+def main():
+	parser = argparse.ArgumentParser()
+	parser.add_argument( "--rbp", default="../bin/rbp" )
+	parser.add_argument( "--out", default="bench_results.json" )
+	parser.add_argument( "--only", default="", help="comma separated scenario names" )
+	parser.add_argument( "--compare", default="", help="previous results to compare against" )
+	parser.add_argument( "--tolerance", type=float, default=0.10 )
+	parser.add_argument( "--hists", type=int, default=1000 )
+	parser.add_argument( "--entries", type=int, default=20000000 )
+	parser.add_argument( "--files", type=int, default=4 )
+	parser.add_argument( "--regen", action="store_true" )
+	args = parser.parse_args()
+	args.rbp = os.path.abspath( args.rbp )
+
+	os.chdir( os.path.dirname( os.path.abspath( __file__ ) ) )
+	if not os.path.exists( "out" ):
+		os.makedirs( "out" )
+	make_data( args )
+
+	only = [ s for s in args.only.split( "," ) if s ]
+	results = []
+	failed = []
+	for name, cfg, unit, amount in SCENARIOS:
+		if only and name not in only:
+			continue
+		if "entries" == unit:
+			amount = amount // 20000000 * args.entries
+		r = run( args, name, cfg, unit, amount )
+		print( "%-16s %8.2f s %10d kB %12.1f %s/s" % ( name, r[ "wall_s" ], r[ "peak_rss_kb" ], r[ "throughput" ], unit ) )
+		results.append( r )
+		if 0 != r[ "status" ]:
+			print( "%-16s FAILED with status %d, see out/%s.log" % ( name, r[ "status" ], name ) )
+			failed.append( name )
+
+	version = subprocess.run( [ "git", "describe", "--always", "--dirty" ], stdout=subprocess.PIPE ).stdout.decode( "utf-8" ).strip()
+	with open( args.out, "w" ) as f:
+		json.dump( { "version" : version, "time" : int( time.time() ), "scenarios" : results }, f, indent=2 )
+	print( "Wrote %s" % args.out )
+
+	# timings of a run that failed are meaningless
+	if failed:
+		print( "Failed scenarios: %s" % ", ".join( failed ) )
+		sys.exit( 1 )
+
+	if args.compare and compare( results, args.compare, args.tolerance ):
+		sys.exit( 1 )
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,194 @@
+#ifndef CHAIN_MANIFEST_H
+#define CHAIN_MANIFEST_H
+
+// RooBarb
+#include "XmlConfig.h"
+using namespace jdb;
+
+// STL
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+
+// ROOT
+#include "TFile.h"
+#include "TTree.h"
+#include "TSystem.h"
+#include "TObjArray.h"
+#include "TDirectory.h"
+
+// Project
+#include "loguru.h"
+
+/* Per-file metadata of a chain, keyed by path, size and mtime
+ * stored in an XML sidecar so that later runs can add files
+ * to a TChain without opening them
+ */
+class ChainManifest {
+public:
+	struct Entry {
+		string url;
+		Long64_t size = -1;
+		Long_t mtime = -1;
+		Long64_t entries = -1;
+		vector<Long64_t> clusters;
+		vector<string> branches;
+	};
+
+protected:
+	string url;
+	map<string, Entry> files;
+	bool modified = false;
+
+public:
+	ChainManifest() {}
+	ChainManifest( string _url ) { load( _url ); }
+
+	void load( string _url ){
+		url = _url;
+		files.clear();
+		if ( gSystem->AccessPathName( url.c_str() ) )
+			return;
+
+		XmlConfig cfg;
+		cfg.loadFile( url );
+		vector<string> paths = cfg.childrenOf( "", "File" );
+		for ( string p : paths ){
+			Entry e;
+			// save() escapes, XmlConfig hands the attributes back as they are written
+			e.url     = unescape( cfg.getString( p + ":url" ) );
+			e.size    = cfg.get<Long64_t>( p + ":size", -1 );
+			e.mtime   = cfg.get<Long_t>( p + ":mtime", -1 );
+			e.entries = cfg.get<Long64_t>( p + ":entries", -1 );
+			for ( string c : cfg.getStringVector( p + ":clusters" ) )
+				e.clusters.push_back( std::stoll( c ) );
+			for ( string b : cfg.getStringVector( p + ":branches" ) )
+				e.branches.push_back( unescape( b ) );
+			files[ e.url ] = e;
+		}
+		LOG_F( INFO, "Loaded manifest %s with %lu files", url.c_str(), files.size() );
+	}
+
+	void save(){
+		if ( false == modified || "" == url ) return;
+		ofstream fout( url.c_str() );
+		fout << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << endl;
+		fout << "<config>" << endl;
+		for ( auto kv : files ){
+			const Entry &e = kv.second;
+			fout << "\t<File url=\"" << escape( e.url ) << "\" size=\"" << e.size << "\" mtime=\"" << e.mtime << "\" entries=\"" << e.entries << "\"";
+			fout << " clusters=\"" << join( e.clusters ) << "\" branches=\"" << escape( join( e.branches ) ) << "\" />" << endl;
+		}
+		fout << "</config>" << endl;
+		fout.close();
+		modified = false;
+		LOG_F( INFO, "Wrote manifest %s with %lu files", url.c_str(), files.size() );
+	}
+
+	// returns the manifest entry for a file, rescanning it if the size or mtime changed
+	Entry get( string _file, string _treeName ){
+		FileStat_t fs;
+		bool statOk = ( 0 == gSystem->GetPathInfo( _file.c_str(), fs ) );
+		if ( files.count( _file ) > 0 && statOk ){
+			const Entry &e = files[ _file ];
+			if ( e.size == fs.fSize && e.mtime == fs.fMtime && e.entries >= 0 )
+				return e;
+		}
+
+		Entry e = scan( _file, _treeName );
+		if ( statOk ){
+			e.size = fs.fSize;
+			e.mtime = fs.fMtime;
+		}
+		files[ _file ] = e;
+		modified = true;
+		return e;
+	}
+
+	Entry scan( string _file, string _treeName ){
+		Entry e;
+		e.url = _file;
+		TDirectory::TContext ctx;
+		TFile * f = TFile::Open( _file.c_str() );
+		if ( nullptr == f || f->IsZombie() ){
+			LOG_F( ERROR, "Cannot open %s for manifest", _file.c_str() );
+			delete f;
+			return e;
+		}
+		TTree * tree = dynamic_cast<TTree*>( f->Get( _treeName.c_str() ) );
+		if ( nullptr != tree ){
+			e.entries = tree->GetEntries();
+			TTree::TClusterIterator it = tree->GetClusterIterator( 0 );
+			Long64_t start = 0;
+			while ( (start = it()) < e.entries )
+				e.clusters.push_back( start );
+			TIter next( tree->GetListOfBranches() );
+			TObject * b = nullptr;
+			while ( (b = next()) )
+				e.branches.push_back( b->GetName() );
+		} else {
+			e.entries = 0;
+			LOG_F( WARNING, "No tree %s in %s", _treeName.c_str(), _file.c_str() );
+		}
+		f->Close();
+		delete f;
+		return e;
+	}
+
+	bool has( string _file ) { return files.count( _file ) > 0; }
+	Entry &operator[]( string _file ) { return files[ _file ]; }
+
+protected:
+	// urls may contain &, quotes or <> (e.g. xrootd options)
+	static string escape( const string &_s ){
+		string r = "";
+		for ( char c : _s ){
+			switch ( c ){
+				case '&': r += "&amp;"; break;
+				case '<': r += "&lt;"; break;
+				case '>': r += "&gt;"; break;
+				case '"': r += "&quot;"; break;
+				case '\'': r += "&apos;"; break;
+				default: r += c;
+			}
+		}
+		return r;
+	}
+
+	// the entities escape() writes, decoded in one pass so "&amp;lt;" stays "&lt;"
+	static string unescape( const string &_s ){
+		static const vector< pair<string, char> > entities = { { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' } };
+		string r = "";
+		for ( size_t i = 0; i < _s.size(); ){
+			bool decoded = false;
+			if ( '&' == _s[i] ){
+				for ( auto &e : entities ){
+					if ( 0 == _s.compare( i, e.first.size(), e.first ) ){
+						r += e.second;
+						i += e.first.size();
+						decoded = true;
+						break;
+					}
+				}
+			}
+			if ( false == decoded )
+				r += _s[ i++ ];
+		}
+		return r;
+	}
+
+	template <typename T>
+	string join( const vector<T> &v ){
+		string r = "";
+		for ( size_t i = 0; i < v.size(); i++ ){
+			if ( i > 0 ) r += ", ";
+			r += toString( v[i] );
+		}
+		return r;
+	}
+	string toString( const string &s ) { return s; }
+	string toString( Long64_t v ) { return std::to_string( v ); }
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef DATA_FILE_POOL_H
+#define DATA_FILE_POOL_H
+
+// STL
+#include <string>
+#include <map>
+#include <list>
+#include <set>
+#include <algorithm>
+
+// ROOT
+#include "TFile.h"
+#include "TDirectory.h"
+
+// Project
+#include "loguru.h"
+
+/* Opens <Data> files on first access and keeps at most
+ * `capacity` handles open, closing the least recently used one.
+ * Objects read from a file are owned by it, callers must clone or
+ * detach anything that needs to outlive an eviction, or pin the file
+ * when the object cannot leave it (trees)
+ */
+class DataFilePool {
+protected:
+	size_t capacity = 128;
+	std::map<std::string, TFile*> handles;
+	std::list<std::string> lru; // most recently used at the front
+	std::set<std::string> pinned; // never evicted
+
+public:
+	DataFilePool() {}
+	~DataFilePool() { closeAll(); }
+
+	void setCapacity( size_t _capacity ) { capacity = std::max( (size_t)1, _capacity ); }
+	size_t getCapacity() const { return capacity; }
+	size_t nOpen() const { return handles.size(); }
+	bool isOpen( std::string _url ) const { return handles.count( _url ) > 0; }
+
+	TFile * get( std::string _url ){
+		if ( handles.count( _url ) > 0 ){
+			touch( _url );
+			return handles[ _url ];
+		}
+
+		// do not let opening a data file change the current directory
+		TDirectory::TContext ctx;
+		TFile * f = TFile::Open( _url.c_str() );
+		if ( nullptr == f || false == f->IsOpen() ){
+			LOG_F( ERROR, "%s cannot be opened", _url.c_str() );
+			delete f;
+			return nullptr;
+		}
+		LOG_F( INFO, "Opened %s (%lu/%lu handles)", _url.c_str(), handles.size() + 1, capacity );
+
+		handles[ _url ] = f;
+		lru.push_front( _url );
+		while ( handles.size() > capacity && evict() ) {}
+		return f;
+	}
+
+	void pin( std::string _url ){
+		if ( pinned.count( _url ) > 0 ) return;
+		pinned.insert( _url );
+		LOG_F( INFO, "Keeping %s open", _url.c_str() );
+	}
+
+	void close( std::string _url ){
+		if ( handles.count( _url ) == 0 ) return;
+		TDirectory::TContext ctx;
+		TFile * f = handles[ _url ];
+		DLOG_F( INFO, "Closing %s", _url.c_str() );
+		f->Close();
+		delete f;
+		handles.erase( _url );
+		lru.remove( _url );
+	}
+
+	void closeAll(){
+		while ( lru.size() > 0 )
+			close( lru.back() );
+		pinned.clear();
+	}
+
+protected:
+	// closes the least recently used file that is not pinned
+	bool evict(){
+		for ( auto it = lru.rbegin(); it != lru.rend(); ++it ){
+			if ( pinned.count( *it ) > 0 ) continue;
+			close( *it );
+			return true;
+		}
+		return false;
+	}
+
+	void touch( std::string _url ){
+		if ( lru.size() > 0 && lru.front() == _url ) return;
+		lru.remove( _url );
+		lru.push_front( _url );
+	}
+};
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef DOWNSAMPLE_H
+#define DOWNSAMPLE_H
+
+// STL
+#include <string>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// ROOT
+#include "TH1.h"
+#include "TH2.h"
+#include "TGraph.h"
+#include "TGraphErrors.h"
+#include "TGraphAsymmErrors.h"
+#include "TAxis.h"
+#include "TVirtualPad.h"
+
+// Project
+#include "loguru.h"
+
+/* Render-side reduction of objects that have far more points than
+ * the pad has pixels. Only the drawn proxy is reduced, the original
+ * object is left untouched
+ */
+class Downsample {
+public:
+	/* downsample="..." is one setting shared by histograms and graphs
+	 *   false, 0     draw everything
+	 *   mean, sum    how the bins of a TH2 are merged
+	 *   lttb, minmax how the points of a graph are picked
+	 * A value for the other kind (e.g. --downsample=sum with a graph) keeps
+	 * the default of this kind, "mean" for histograms and "lttb" for graphs.
+	 * Returns "" when disabled
+	 */
+	static std::string mode( std::string _spec, bool _graph ){
+		std::transform( _spec.begin(), _spec.end(), _spec.begin(), ::tolower );
+		if ( "false" == _spec || "0" == _spec ) return "";
+		if ( _graph && ( "lttb" == _spec || "minmax" == _spec ) ) return _spec;
+		if ( false == _graph && ( "mean" == _spec || "sum" == _spec ) ) return _spec;
+		if ( "" != _spec && "true" != _spec && "1" != _spec && "mean" != _spec && "sum" != _spec && "lttb" != _spec && "minmax" != _spec )
+			LOG_F( WARNING, "Unknown downsample=\"%s\", expected false, mean, sum, lttb or minmax", _spec.c_str() );
+		return _graph ? "lttb" : "mean";
+	}
+
+	// size of the pad's frame (inside the margins) in pixels
+	static bool framePixels( TVirtualPad * _pad, int &_w, int &_h ){
+		if ( nullptr == _pad ) return false;
+		_w = (int)( _pad->GetWw() * _pad->GetAbsWNDC() * ( 1.0 - _pad->GetLeftMargin() - _pad->GetRightMargin() ) );
+		_h = (int)( _pad->GetWh() * _pad->GetAbsHNDC() * ( 1.0 - _pad->GetTopMargin() - _pad->GetBottomMargin() ) );
+		return _w > 0 && _h > 0;
+	}
+
+	// bins merged into one so that about one is left per pixel, the last group may be smaller
+	static int groupFor( int _nBins, int _nPixels ){
+		if ( _nPixels <= 0 || _nBins <= _nPixels ) return 1;
+		return _nBins / _nPixels;
+	}
+
+	// largest divisor of _nBins that still leaves at least _nPixels bins, profiles can only be rebinned by those
+	static int divisorFor( int _nBins, int _nPixels ){
+		if ( _nPixels <= 0 || _nBins <= _nPixels ) return 1;
+		for ( int g = _nBins / _nPixels; g > 1; g-- ){
+			if ( _nBins % g == 0 ) return g;
+		}
+		return 1;
+	}
+
+	// edges of the axis when every _group bins are merged, keeps a remainder as a narrower last bin
+	static std::vector<double> groupedEdges( const TAxis * _axis, int _group ){
+		std::vector<double> edges;
+		for ( int i = 1; i <= _axis->GetNbins(); i += _group )
+			edges.push_back( _axis->GetBinLowEdge( i ) );
+		edges.push_back( _axis->GetXmax() );
+		return edges;
+	}
+
+	/* Rebinned clone of a TH2 with about one bin per pixel, nullptr if
+	 * the histogram has fewer than _oversample bins per pixel on both axes.
+	 * Bin counts without a fitting divisor (e.g. primes) get a narrower last
+	 * bin. In "mean" mode the merged contents are divided by the number of
+	 * bins merged so that the color scale matches the original
+	 */
+	static TH2 * pixelProxy( TH2 * _h, int _wPx, int _hPx, double _oversample = 2.0, std::string _mode = "mean" ){
+		if ( nullptr == _h || _h->InheritsFrom( "TH2Poly" ) ) return nullptr;
+		int nx = _h->GetNbinsX();
+		int ny = _h->GetNbinsY();
+		if ( nx <= _oversample * _wPx && ny <= _oversample * _hPx ) return nullptr;
+
+		// profiles already average when rebinned, but only by divisors
+		bool profile = _h->InheritsFrom( "TProfile2D" );
+		int gx = 1, gy = 1;
+		if ( nx > _oversample * _wPx ) gx = profile ? divisorFor( nx, _wPx ) : groupFor( nx, _wPx );
+		if ( ny > _oversample * _hPx ) gy = profile ? divisorFor( ny, _hPx ) : groupFor( ny, _hPx );
+		if ( gx * gy <= 1 ){
+			LOG_F( INFO, "Drawing %s with all %dx%d bins, its bins cannot be grouped for a %dx%d px frame", _h->GetName(), nx, ny, _wPx, _hPx );
+			return nullptr;
+		}
+
+		TH2 * proxy = (TH2*)_h->Clone( ( std::string( _h->GetName() ) + "_px" ).c_str() );
+		proxy->SetDirectory( nullptr );
+		if ( profile || ( nx % gx == 0 && ny % gy == 0 ) ){
+			proxy->Rebin2D( gx, gy );
+			if ( "mean" == _mode && false == profile )
+				proxy->Scale( 1.0 / ( gx * gy ) );
+		} else {
+			merge( _h, proxy, gx, gy, "mean" == _mode );
+		}
+
+		LOG_F( INFO, "Drawing %s as %dx%d proxy of %dx%d bins (frame is %dx%d px)", _h->GetName(), proxy->GetNbinsX(), proxy->GetNbinsY(), nx, ny, _wPx, _hPx );
+		return proxy;
+	}
+
+	// fills _proxy (a clone of _h, keeping its style) with groups of _gx x _gy bins, under- and overflow stay apart
+	static void merge( TH2 * _h, TH2 * _proxy, int _gx, int _gy, bool _mean ){
+		int nx = _h->GetNbinsX();
+		int ny = _h->GetNbinsY();
+		std::vector<double> ex = groupedEdges( _h->GetXaxis(), _gx );
+		std::vector<double> ey = groupedEdges( _h->GetYaxis(), _gy );
+		int px = ex.size() - 1, py = ey.size() - 1;
+		double entries = _h->GetEntries();
+		_proxy->Reset();
+		_proxy->SetBins( px, ex.data(), py, ey.data() );
+
+		const TArrayD * w2 = _h->GetSumw2N() > 0 ? _h->GetSumw2() : nullptr;
+		TArrayD * pw2 = _proxy->GetSumw2N() > 0 ? _proxy->GetSumw2() : nullptr;
+		std::vector<int> nMerged( _proxy->GetNcells(), 0 );
+		for ( int j = 0; j <= ny + 1; j++ ){
+			int pj = 0 == j ? 0 : ( j > ny ? py + 1 : ( j - 1 ) / _gy + 1 );
+			for ( int i = 0; i <= nx + 1; i++ ){
+				int pi = 0 == i ? 0 : ( i > nx ? px + 1 : ( i - 1 ) / _gx + 1 );
+				int bin = _h->GetBin( i, j );
+				int pbin = _proxy->GetBin( pi, pj );
+				_proxy->AddBinContent( pbin, _h->GetBinContent( bin ) );
+				if ( pw2 ) pw2->AddAt( w2 ? w2->At( bin ) : std::fabs( _h->GetBinContent( bin ) ), pbin );
+				nMerged[ pbin ]++;
+			}
+		}
+		if ( _mean ){
+			for ( int b = 0; b < _proxy->GetNcells(); b++ ){
+				if ( nMerged[ b ] <= 1 ) continue;
+				_proxy->SetBinContent( b, _proxy->GetBinContent( b ) / nMerged[ b ] );
+				if ( pw2 ) pw2->SetAt( pw2->At( b ) / ( (double)nMerged[ b ] * nMerged[ b ] ), b );
+			}
+		}
+		_proxy->SetEntries( entries );
+	}
+
+	/* Largest-Triangle-Three-Buckets: keeps _threshold points, the first and
+	 * last point plus the point of each bucket that spans the largest triangle
+	 * with the previously kept point and the mean of the next bucket
+	 */
+	static std::vector<int> lttb( const double * _x, const double * _y, int _n, int _threshold ){
+		std::vector<int> keep;
+		if ( _threshold >= _n || _threshold < 3 ){
+			for ( int i = 0; i < _n; i++ ) keep.push_back( i );
+			return keep;
+		}
+		keep.reserve( _threshold );
+		double every = (double)( _n - 2 ) / ( _threshold - 2 );
+		int a = 0;
+		keep.push_back( a );
+		for ( int i = 0; i < _threshold - 2; i++ ){
+			int nextStart = (int)( ( i + 1 ) * every ) + 1;
+			int nextEnd   = std::min( (int)( ( i + 2 ) * every ) + 1, _n );
+			double ax = 0, ay = 0;
+			for ( int j = nextStart; j < nextEnd; j++ ){ ax += _x[j]; ay += _y[j]; }
+			int nNext = std::max( nextEnd - nextStart, 1 );
+			ax /= nNext; ay /= nNext;
+
+			int start = (int)( i * every ) + 1;
+			int end   = (int)( ( i + 1 ) * every ) + 1;
+			double maxArea = -1;
+			int chosen = start;
+			for ( int j = start; j < end; j++ ){
+				double area = std::fabs( ( _x[a] - ax ) * ( _y[j] - _y[a] ) - ( _x[a] - _x[j] ) * ( ay - _y[a] ) );
+				if ( area > maxArea ){
+					maxArea = area;
+					chosen = j;
+				}
+			}
+			keep.push_back( chosen );
+			a = chosen;
+		}
+		keep.push_back( _n - 1 );
+		return keep;
+	}
+
+	// first, last, min and max point of each of _nBuckets equal ranges in x
+	static std::vector<int> minmax( const double * _x, const double * _y, int _n, int _nBuckets ){
+		std::vector<int> keep;
+		if ( _n == 0 ) return keep;
+		double x0 = _x[0], x1 = _x[_n - 1];
+		double w = ( x1 - x0 ) / std::max( _nBuckets, 1 );
+		int i = 0;
+		while ( i < _n ){
+			int b = w > 0 ? (int)( ( _x[i] - x0 ) / w ) : 0;
+			int first = i, iMin = i, iMax = i;
+			while ( i < _n && ( w <= 0 || (int)( ( _x[i] - x0 ) / w ) == b || ( b >= _nBuckets - 1 ) ) ){
+				if ( _y[i] < _y[iMin] ) iMin = i;
+				if ( _y[i] > _y[iMax] ) iMax = i;
+				i++;
+			}
+			int bucket[] = { first, std::min( iMin, iMax ), std::max( iMin, iMax ), i - 1 };
+			for ( int k : bucket )
+				if ( keep.size() == 0 || keep.back() != k ) keep.push_back( k );
+		}
+		return keep;
+	}
+
+	/* Draw-only copy of a graph reduced to about _oversample points per
+	 * pixel of _wPx, nullptr if it is already small enough or x is not
+	 * ordered. Errors of the kept points are preserved
+	 */
+	static TGraph * graphProxy( TGraph * _g, int _wPx, double _oversample = 2.0, std::string _mode = "lttb" ){
+		if ( nullptr == _g || _wPx <= 0 ) return nullptr;
+		int n = _g->GetN();
+		int target = (int)( _oversample * _wPx );
+		if ( n <= target || target < 3 ) return nullptr;
+
+		const double * x = _g->GetX();
+		const double * y = _g->GetY();
+		for ( int i = 1; i < n; i++ ){
+			if ( x[i] < x[i-1] ){
+				LOG_F( INFO, "%s is not ordered in x, drawing all %d points", _g->GetName(), n );
+				return nullptr;
+			}
+		}
+
+		std::vector<int> keep = "minmax" == _mode ? minmax( x, y, n, _wPx ) : lttb( x, y, n, target );
+		int m = keep.size();
+
+		TGraph * proxy = nullptr;
+		if ( _g->InheritsFrom( "TGraphAsymmErrors" ) ){
+			TGraphAsymmErrors * ge = (TGraphAsymmErrors*)_g;
+			TGraphAsymmErrors * p = new TGraphAsymmErrors( m );
+			for ( int i = 0; i < m; i++ ){
+				int k = keep[i];
+				p->SetPoint( i, x[k], y[k] );
+				p->SetPointError( i, ge->GetErrorXlow( k ), ge->GetErrorXhigh( k ), ge->GetErrorYlow( k ), ge->GetErrorYhigh( k ) );
+			}
+			proxy = p;
+		} else if ( _g->InheritsFrom( "TGraphErrors" ) ){
+			TGraphErrors * ge = (TGraphErrors*)_g;
+			TGraphErrors * p = new TGraphErrors( m );
+			for ( int i = 0; i < m; i++ ){
+				int k = keep[i];
+				p->SetPoint( i, x[k], y[k] );
+				p->SetPointError( i, ge->GetErrorX( k ), ge->GetErrorY( k ) );
+			}
+			proxy = p;
+		} else {
+			proxy = new TGraph( m );
+			for ( int i = 0; i < m; i++ )
+				proxy->SetPoint( i, x[ keep[i] ], y[ keep[i] ] );
+		}
+
+		proxy->SetName( ( std::string( _g->GetName() ) + "_px" ).c_str() );
+		proxy->SetTitle( _g->GetTitle() );
+		_g->TAttLine::Copy( *proxy );
+		_g->TAttFill::Copy( *proxy );
+		_g->TAttMarker::Copy( *proxy );
+		proxy->GetXaxis()->SetTitle( _g->GetXaxis()->GetTitle() );
+		proxy->GetYaxis()->SetTitle( _g->GetYaxis()->GetTitle() );
+
+		LOG_F( INFO, "Drawing %s with %d of %d points (%s, frame is %d px wide)", _g->GetName(), m, n, _mode.c_str(), _wPx );
+		return proxy;
+	}
+};
+
+#endif
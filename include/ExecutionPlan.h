@@ -0,0 +1,90 @@
+#ifndef EXECUTION_PLAN_H
+#define EXECUTION_PLAN_H
+
+// STL
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+
+// ROOT
+#include "Rtypes.h"
+
+/* The concrete work of a config, collected by --explain
+ * without reading data, drawing or exporting
+ */
+class ExecutionPlan {
+public:
+	struct Item {
+		std::string kind;   // pass, load, transform, export, plot, interpreter
+		std::string tag;
+		std::string path;
+		std::string what;
+		Long64_t entries = -1;
+		Long64_t bytes = -1;
+		int repeat = 0;     // how many times the same work was seen before
+	};
+
+protected:
+	std::vector<Item> items;
+	std::map<std::string, int> seen;
+
+public:
+	// _key identifies identical work, repeated keys are flagged as redundant
+	Item &add( std::string _kind, std::string _tag, std::string _path, std::string _what, std::string _key = "" ){
+		Item it;
+		it.kind = _kind;
+		it.tag = _tag;
+		it.path = _path;
+		it.what = _what;
+		if ( "" != _key )
+			it.repeat = seen[ _kind + "|" + _key ]++;
+		items.push_back( it );
+		return items.back();
+	}
+
+	size_t size() const { return items.size(); }
+
+	void print( std::ostream &out ){
+		struct Total { long n = 0, redundant = 0; Long64_t entries = 0, bytes = 0; };
+		std::map<std::string, Total> totals;
+
+		out << "==================== Execution plan ====================" << std::endl;
+		for ( const Item &it : items ){
+			out << std::left << std::setw( 14 ) << ( "[" + it.kind + "]" ) << std::setw( 12 ) << it.tag << it.what;
+			if ( it.entries >= 0 ) out << "  entries=" << it.entries;
+			if ( it.bytes >= 0 ) out << "  bytes=" << human( it.bytes );
+			if ( it.repeat > 0 ) out << "  <-- REDUNDANT (seen " << it.repeat << "x before)";
+			out << "  @ " << it.path << std::endl;
+
+			Total &t = totals[ it.kind ];
+			t.n++;
+			if ( it.repeat > 0 ) t.redundant++;
+			if ( it.entries > 0 ) t.entries += it.entries;
+			if ( it.bytes > 0 ) t.bytes += it.bytes;
+		}
+
+		out << "======================== Summary =======================" << std::endl;
+		for ( auto kv : totals ){
+			out << std::left << std::setw( 14 ) << kv.first << std::right << std::setw( 8 ) << kv.second.n;
+			if ( kv.second.redundant > 0 ) out << "  redundant=" << kv.second.redundant;
+			if ( kv.second.entries > 0 ) out << "  entries=" << kv.second.entries;
+			if ( kv.second.bytes > 0 ) out << "  bytes=" << human( kv.second.bytes );
+			out << std::endl;
+		}
+	}
+
+	static std::string human( Long64_t _bytes ){
+		const char * units[] = { "B", "kB", "MB", "GB", "TB" };
+		double v = _bytes;
+		int i = 0;
+		while ( v >= 1024 && i < 4 ){ v /= 1024; i++; }
+		char buf[32];
+		snprintf( buf, sizeof(buf), "%.1f %s", v, units[i] );
+		return buf;
+	}
+};
+
+#endif
@@ -0,0 +1,353 @@
+#ifndef EXPORT_SINK_H
+#define EXPORT_SINK_H
+
+// STL
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <cstdlib>
+
+// POSIX
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// ROOT
+#include "TPad.h"
+#include "TCanvas.h"
+#include "TImage.h"
+#include "TString.h"
+#ifdef JSON_EXPORT
+#include "TBufferJSON.h"
+#endif
+
+// Project
+#include "loguru.h"
+
+/* Where an Export goes. The file sink prints the pad to its url, the
+ * others take the encoded bytes: kept in memory, handed to a callback
+ * or appended to one tar archive so that many small figures do not
+ * cost a file each
+ */
+class ExportSink {
+public:
+	virtual ~ExportSink() {}
+	virtual void put( TPad * _pad, const std::string &_url ){
+		putBytes( _url, encode( _pad, _url ) );
+	}
+	// an export that is already encoded, e.g. a finished multi-page document
+	virtual void putBytes( const std::string &_url, const std::string &_bytes ) = 0;
+	// called at the end of a config, archives are finished here
+	virtual void close() {}
+
+	// the bytes _pad would be written as to _url, the format follows the extension
+	static std::string encode( TPad * _pad, const std::string &_url ){
+		std::string ext = extension( _url );
+		if ( "json" == ext ){
+#ifdef JSON_EXPORT
+			return TBufferJSON::ConvertToJSON( _pad ).Data();
+#else
+			LOG_F( INFO, "JSON export requires compiling with libRIO" );
+			return "";
+#endif
+		}
+
+		// TImage only encodes PNG into a buffer
+		std::string bytes;
+		if ( "png" == ext ){
+			TImage * img = TImage::Create();
+			if ( nullptr != img ){
+				img->FromPad( _pad );
+				char * buffer = nullptr;
+				int size = 0;
+				img->GetImageBuffer( &buffer, &size, TImage::kPng );
+				bytes = std::string( buffer ? buffer : "", buffer ? size : 0 );
+				free( buffer );
+				delete img;
+			}
+		} else {
+			// everything else (gif, jpg, pdf, svg, ...) is printed into a scratch file
+			std::string path;
+			int fd = scratch( path );
+			if ( fd < 0 ){
+				LOG_F( ERROR, "Cannot create a scratch file for %s", _url.c_str() );
+				return "";
+			}
+			_pad->Print( path.c_str(), ext.c_str() );
+			bytes = release( fd, path );
+		}
+		if ( bytes.size() == 0 )
+			LOG_F( ERROR, "Encoding %s as %s produced no bytes", _url.c_str(), ext.c_str() );
+		return bytes;
+	}
+
+	/* An anonymous in-memory file on Linux (memfd, glibc >= 2.27), a
+	 * temporary file elsewhere or when the path needs a _suffix (ROOT
+	 * picks the format of a multi-page document from it). Returns the
+	 * descriptor and a path ROOT can print to, release() reads it back
+	 * and removes it
+	 */
+	static int scratch( std::string &_path, const std::string &_suffix = "" ){
+#if defined( __linux__ ) && defined( MFD_CLOEXEC )
+		int fd = "" == _suffix ? memfd_create( "rbp_export", 0 ) : -1;
+		if ( fd >= 0 ){
+			_path = TString::Format( "/proc/self/fd/%d", fd ).Data();
+			return fd;
+		}
+#endif
+		const char * tmp = getenv( "TMPDIR" );
+		std::string templ = std::string( tmp ? tmp : "/tmp" ) + "/rbp_exportXXXXXX" + _suffix;
+		std::vector<char> name( templ.begin(), templ.end() );
+		name.push_back( '\0' );
+		_path = "";
+		int tmpFd = mkstemps( name.data(), _suffix.size() );
+		if ( tmpFd >= 0 )
+			_path = name.data();
+		return tmpFd;
+	}
+
+	static std::string release( int _fd, const std::string &_path ){
+		std::string bytes;
+		char chunk[ 65536 ];
+		ssize_t n = 0;
+		::lseek( _fd, 0, SEEK_SET );
+		while ( (n = ::read( _fd, chunk, sizeof( chunk ) )) > 0 )
+			bytes.append( chunk, n );
+		::close( _fd );
+		if ( 0 != _path.find( "/proc/self/fd/" ) )
+			::unlink( _path.c_str() );
+		return bytes;
+	}
+
+	static std::string extension( const std::string &_url ){
+		std::string ext = _url.substr( _url.find_last_of( '.' ) + 1 );
+		std::transform( ext.begin(), ext.end(), ext.begin(), ::tolower );
+		return ext;
+	}
+};
+
+class FileExportSink : public ExportSink {
+public:
+	virtual void put( TPad * _pad, const std::string &_url ){
+		if ( "json" == extension( _url ) ){
+			std::string bytes = encode( _pad, _url );
+			if ( bytes.size() == 0 ) return;
+			std::ofstream fout( _url.c_str(), std::ios::binary );
+			fout << bytes;
+			return;
+		}
+		_pad->Print( _url.c_str() );
+	}
+
+	virtual void putBytes( const std::string &_url, const std::string &_bytes ){
+		std::ofstream fout( _url.c_str(), std::ios::binary );
+		fout << _bytes;
+	}
+};
+
+// keeps (url, bytes) of every export until taken
+class MemoryExportSink : public ExportSink {
+public:
+	std::vector< std::pair<std::string, std::string> > exports;
+
+	virtual void putBytes( const std::string &_url, const std::string &_bytes ){
+		exports.push_back( std::make_pair( _url, _bytes ) );
+		LOG_F( INFO, "Captured %s (%lu bytes)", _url.c_str(), _bytes.size() );
+	}
+};
+
+class CallbackExportSink : public ExportSink {
+public:
+	typedef std::function<void( const std::string &, const std::string & )> Callback;
+	CallbackExportSink( Callback _callback ) : callback( _callback ) {}
+
+	virtual void putBytes( const std::string &_url, const std::string &_bytes ){
+		callback( _url, _bytes );
+	}
+
+protected:
+	Callback callback;
+};
+
+/* Appends every export as a member of one ustar archive. The archive
+ * is started fresh once per process, later configs of a batch reopen it
+ * and continue over its end-of-archive blocks
+ */
+class TarExportSink : public ExportSink {
+public:
+	TarExportSink( std::string _archive ) : archive( _archive ) {
+		if ( started().count( archive ) > 0 ){
+			out.open( archive.c_str(), std::ios::binary | std::ios::in | std::ios::out );
+			out.seekp( 0, std::ios::end );
+			std::streamoff end = out.tellp();
+			if ( end >= 1024 )
+				out.seekp( end - 1024 );
+		} else {
+			out.open( archive.c_str(), std::ios::binary | std::ios::out | std::ios::trunc );
+			started().insert( archive );
+		}
+		if ( false == out.good() )
+			LOG_F( ERROR, "Cannot open %s", archive.c_str() );
+	}
+	~TarExportSink() { close(); }
+
+	virtual void put( TPad * _pad, const std::string &_url ){
+		if ( false == out.is_open() ) return;
+		putBytes( _url, encode( _pad, _url ) );
+	}
+
+	virtual void putBytes( const std::string &_url, const std::string &_bytes ){
+		if ( false == out.is_open() ) return;
+		header( _url, _bytes.size() );
+		out.write( _bytes.data(), _bytes.size() );
+		pad( _bytes.size() );
+		nMembers++;
+	}
+
+	virtual void close(){
+		if ( false == out.is_open() ) return;
+		// an archive ends with two empty records
+		std::string end( 1024, '\0' );
+		out.write( end.data(), end.size() );
+		out.close();
+		LOG_F( INFO, "Wrote %lu exports to %s", nMembers, archive.c_str() );
+	}
+
+protected:
+	std::string archive;
+	std::fstream out;
+	size_t nMembers = 0;
+
+	// archives written by this process so far
+	static std::set<std::string> &started(){
+		static std::set<std::string> s;
+		return s;
+	}
+
+	void header( std::string _name, size_t _size ){
+		char h[512];
+		memset( h, 0, sizeof( h ) );
+		while ( 0 == _name.find( "/" ) ) _name = _name.substr( 1 );
+		// names longer than 100 characters are split into prefix/name at a '/'
+		std::string prefix;
+		if ( _name.size() > 99 ){
+			size_t split = _name.find( '/', _name.size() - 99 );
+			if ( split != std::string::npos && split <= 154 ){
+				prefix = _name.substr( 0, split );
+				_name = _name.substr( split + 1 );
+			} else {
+				LOG_F( WARNING, "%s is too long for a tar member, truncating", _name.c_str() );
+				_name = _name.substr( _name.size() - 99 );
+			}
+		}
+		strncpy( h, _name.c_str(), 99 );
+		snprintf( h + 100, 8, "%07o", 0644 );
+		snprintf( h + 108, 8, "%07o", 0 );
+		snprintf( h + 116, 8, "%07o", 0 );
+		snprintf( h + 124, 12, "%011lo", (unsigned long)_size );
+		snprintf( h + 136, 12, "%011lo", (unsigned long)time( nullptr ) );
+		h[156] = '0';
+		memcpy( h + 257, "ustar", 6 );
+		memcpy( h + 263, "00", 2 );
+		strncpy( h + 345, prefix.c_str(), 154 );
+
+		// the checksum is computed with its own field set to spaces
+		memset( h + 148, ' ', 8 );
+		unsigned int sum = 0;
+		for ( int i = 0; i < 512; i++ ) sum += (unsigned char)h[i];
+		snprintf( h + 148, 8, "%06o", sum );
+		h[155] = ' ';
+		out.write( h, sizeof( h ) );
+	}
+
+	void pad( size_t _size ){
+		size_t rest = _size % 512;
+		if ( rest > 0 ){
+			std::string zeros( 512 - rest, '\0' );
+			out.write( zeros.data(), zeros.size() );
+		}
+	}
+};
+
+/* One multi-page PDF (or PS). The document is opened with the first
+ * page and every page is written as soon as it is added, close() ends
+ * it. Page titles become the document outline. Only one document can be
+ * open at a time since ROOT keeps it in gVirtualPS. With a target sink
+ * the document is built in a scratch file and handed to the target as
+ * one export when it is closed
+ */
+class PdfBookExportSink : public ExportSink {
+public:
+	PdfBookExportSink( std::string _url ) : url( _url ) {}
+	~PdfBookExportSink() { close(); }
+
+	virtual void put( TPad * _pad, const std::string &_url ){
+		page( _pad, _url.substr( _url.find_last_of( '/' ) + 1 ) );
+	}
+
+	virtual void putBytes( const std::string &_url, const std::string & ){
+		LOG_F( WARNING, "Only pads can be added to %s, not %s", url.c_str(), _url.c_str() );
+	}
+
+	// only before the first page
+	void deliverTo( ExportSink * _target ){
+		if ( false == open && false == finished )
+			target = _target;
+	}
+
+	void page( TPad * _pad, std::string _title ){
+		if ( finished ){
+			LOG_F( WARNING, "%s is closed already, not adding %s", url.c_str(), _title.c_str() );
+			return;
+		}
+		if ( false == open ){
+			path = url;
+			// the scratch file keeps the extension, without it ROOT writes PostScript
+			if ( nullptr != target && ( fd = scratch( path, "." + extension( url ) ) ) < 0 ){
+				LOG_F( ERROR, "Cannot create a scratch file for %s", url.c_str() );
+				return;
+			}
+			_pad->Print( ( path + "[" ).c_str() );
+			open = true;
+		}
+		_pad->Print( path.c_str(), ( "Title:" + _title ).c_str() );
+		nPages++;
+	}
+
+	virtual void close(){
+		if ( false == open ) return;
+		// closing needs a pad but not the one the pages were drawn on, that one may be gone
+		TVirtualPad * current = gPad;
+		TCanvas * c = new TCanvas( "pdfbook_close", "", 10, 10 );
+		c->Print( ( path + "]" ).c_str() );
+		delete c;
+		gPad = current;
+		open = false;
+		finished = true;
+		if ( nullptr != target ){
+			target->putBytes( url, release( fd, path ) );
+			fd = -1;
+		}
+		LOG_F( INFO, "Wrote %lu pages to %s", nPages, url.c_str() );
+	}
+
+protected:
+	std::string url;
+	// where the pages are printed, url itself unless there is a target
+	std::string path;
+	ExportSink * target = nullptr;
+	int fd = -1;
+	bool open = false;
+	bool finished = false; // opening again would overwrite the pages
+	size_t nPages = 0;
+};
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef HISTO_ACCUMULATOR_H
+#define HISTO_ACCUMULATOR_H
+
+// STL
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+
+// ROOT
+#include "TROOT.h"
+#include "TFile.h"
+#include "TKey.h"
+#include "TH1.h"
+#include "TDirectory.h"
+
+// Project
+#include "loguru.h"
+
+/* Sums histograms with the same binning without keeping them around.
+ * Contents, sum of squared weights and statistics are accumulated in
+ * double precision (optionally Kahan compensated), histograms read from
+ * files are streamed into one reusable buffer per worker. With several
+ * workers every worker sums a contiguous share of the inputs and the
+ * partial sums are combined pairwise.
+ * Profiles (whose bin content is a mean) and inputs whose axes do not
+ * match are summed with TH1::Add instead
+ */
+class HistoAccumulator {
+public:
+	// an input is either a histogram in memory or a key in a file
+	struct Input {
+		TH1 * h = nullptr;
+		std::string url;
+		std::string name;
+	};
+
+protected:
+	bool kahan = false;
+	bool initialized = false;
+	std::vector<double> sum, comp, sumw2, comp2;
+	std::vector<double> stats, statsComp;
+	double entries = 0;
+	long nAdded = 0;
+	TH1 * shape = nullptr; // empty copy of the first input, defines the binning
+	TH1 * added = nullptr; // running sum once TH1::Add has taken over
+
+public:
+	HistoAccumulator( bool _kahan = false ) : kahan( _kahan ) {}
+	~HistoAccumulator() { delete shape; delete added; }
+	HistoAccumulator( const HistoAccumulator & ) = delete;
+	HistoAccumulator &operator=( const HistoAccumulator & ) = delete;
+
+	long size() const { return nAdded; }
+
+	bool add( TH1 * _h ){
+		if ( nullptr == _h ) return false;
+		if ( nullptr == added && ( needsAdd( _h ) || ( initialized && false == sameAxes( shape, _h ) ) ) )
+			switchToAdd( _h );
+		if ( nullptr != added ){
+			if ( false == added->Add( _h ) ){
+				LOG_F( WARNING, "Cannot add %s, its binning does not match", _h->GetName() );
+				return false;
+			}
+			nAdded++;
+			return true;
+		}
+		if ( false == initialized ) init( _h );
+		if ( _h->GetNcells() != (int)sum.size() ){
+			LOG_F( WARNING, "Cannot add %s, %d cells instead of %lu", _h->GetName(), _h->GetNcells(), sum.size() );
+			return false;
+		}
+		const TArrayD * w2 = _h->GetSumw2N() > 0 ? _h->GetSumw2() : nullptr;
+		for ( size_t i = 0; i < sum.size(); i++ ){
+			double v = _h->GetBinContent( i );
+			accumulate( sum[i], comp[i], v );
+			accumulate( sumw2[i], comp2[i], w2 ? w2->At( i ) : std::fabs( v ) );
+		}
+		double s[ TH1::kNstat ] = { 0 };
+		_h->GetStats( s );
+		for ( int i = 0; i < TH1::kNstat; i++ )
+			accumulate( stats[i], statsComp[i], s[i] );
+		entries += _h->GetEntries();
+		nAdded++;
+		return true;
+	}
+
+	void merge( const HistoAccumulator &_other ){
+		if ( false == _other.initialized && nullptr == _other.added ) return;
+		if ( nullptr != added || nullptr != _other.added || ( initialized && false == sameAxes( shape, _other.shape ) ) ){
+			TDirectory::TContext ctx( nullptr );
+			TH1 * partial = _other.result( "accumulator_partial" );
+			if ( nullptr == added ) switchToAdd( partial );
+			if ( false == added->Add( partial ) )
+				LOG_F( WARNING, "Cannot merge partial sums with different binning" );
+			else
+				nAdded += _other.nAdded;
+			delete partial;
+			return;
+		}
+		if ( false == initialized ){
+			init( _other.shape );
+		} else if ( _other.sum.size() != sum.size() ){
+			LOG_F( WARNING, "Cannot merge partial sums with different binning" );
+			return;
+		}
+		for ( size_t i = 0; i < sum.size(); i++ ){
+			accumulate( sum[i], comp[i], _other.sum[i] );
+			accumulate( sum[i], comp[i], _other.comp[i] );
+			accumulate( sumw2[i], comp2[i], _other.sumw2[i] );
+			accumulate( sumw2[i], comp2[i], _other.comp2[i] );
+		}
+		for ( int i = 0; i < TH1::kNstat; i++ ){
+			accumulate( stats[i], statsComp[i], _other.stats[i] );
+			accumulate( stats[i], statsComp[i], _other.statsComp[i] );
+		}
+		entries += _other.entries;
+		nAdded += _other.nAdded;
+	}
+
+	// a new histogram holding the sum, owned by the caller
+	TH1 * result( std::string _name ) const {
+		if ( nullptr != added ){
+			TH1 * h = (TH1*)added->Clone( _name.c_str() );
+			h->SetDirectory( nullptr );
+			return h;
+		}
+		if ( false == initialized ) return nullptr;
+		TH1 * h = (TH1*)shape->Clone( _name.c_str() );
+		if ( h->GetSumw2N() == 0 ) h->Sumw2();
+		TArrayD * w2 = h->GetSumw2();
+		for ( size_t i = 0; i < sum.size(); i++ ){
+			h->SetBinContent( i, sum[i] + comp[i] );
+			w2->SetAt( sumw2[i] + comp2[i], i );
+		}
+		double s[ TH1::kNstat ];
+		for ( int i = 0; i < TH1::kNstat; i++ )
+			s[i] = stats[i] + statsComp[i];
+		h->PutStats( s );
+		h->SetEntries( entries );
+		return h;
+	}
+
+	/* Sums all inputs with _nThreads workers. File inputs are opened by
+	 * each worker separately, one file at a time, and read with TKey::Read
+	 * into one buffer. Inputs from the same file should be next to each other
+	 */
+	static TH1 * sumAll( const std::vector<Input> &_inputs, std::string _name, int _nThreads = 1, bool _kahan = false ){
+		if ( _inputs.size() == 0 ) return nullptr;
+		int nWorkers = std::max( 1, std::min( _nThreads, (int)_inputs.size() ) );
+		std::vector< std::unique_ptr<HistoAccumulator> > partial;
+		for ( int t = 0; t < nWorkers; t++ )
+			partial.push_back( std::unique_ptr<HistoAccumulator>( new HistoAccumulator( _kahan ) ) );
+
+		size_t step = ( _inputs.size() + nWorkers - 1 ) / nWorkers;
+		if ( nWorkers == 1 ){
+			partial[0]->addAll( _inputs, 0, _inputs.size() );
+		} else {
+			ROOT::EnableThreadSafety();
+			std::vector<std::thread> workers;
+			for ( int t = 0; t < nWorkers; t++ ){
+				size_t begin = t * step;
+				size_t end = std::min( _inputs.size(), begin + step );
+				workers.push_back( std::thread( [&partial, &_inputs, t, begin, end](){
+					partial[t]->addAll( _inputs, begin, end );
+				} ) );
+			}
+			for ( auto &w : workers ) w.join();
+		}
+
+		// pairwise reduction, the merges of one level run concurrently
+		for ( int stride = 1; stride < nWorkers; stride *= 2 ){
+			std::vector<std::thread> mergers;
+			for ( int t = 0; t + stride < nWorkers; t += 2 * stride ){
+				HistoAccumulator * a = partial[t].get();
+				HistoAccumulator * b = partial[t + stride].get();
+				mergers.push_back( std::thread( [a, b](){ a->merge( *b ); } ) );
+			}
+			for ( auto &m : mergers ) m.join();
+		}
+
+		LOG_F( INFO, "Summed %ld of %lu histograms into %s (%d workers%s)", partial[0]->size(), _inputs.size(), _name.c_str(), nWorkers, _kahan ? ", compensated" : "" );
+		return partial[0]->result( _name );
+	}
+
+	// bin contents of profiles are means and of TH2Poly bins are not cells, those are left to TH1::Add
+	static bool needsAdd( const TH1 * _h ){
+		return _h->InheritsFrom( "TProfile" ) || _h->InheritsFrom( "TProfile2D" ) || _h->InheritsFrom( "TProfile3D" ) || _h->InheritsFrom( "TH2Poly" );
+	}
+
+	static bool sameAxis( const TAxis * _a, const TAxis * _b ){
+		if ( _a->GetNbins() != _b->GetNbins() || _a->GetXmin() != _b->GetXmin() || _a->GetXmax() != _b->GetXmax() )
+			return false;
+		const TArrayD * ea = _a->GetXbins();
+		const TArrayD * eb = _b->GetXbins();
+		if ( ea->GetSize() != eb->GetSize() ) return false;
+		for ( int i = 0; i < ea->GetSize(); i++ )
+			if ( ea->At( i ) != eb->At( i ) ) return false;
+		return true;
+	}
+
+	static bool sameAxes( const TH1 * _a, const TH1 * _b ){
+		if ( nullptr == _a || nullptr == _b ) return false;
+		if ( _a->GetDimension() != _b->GetDimension() ) return false;
+		return sameAxis( _a->GetXaxis(), _b->GetXaxis() ) && sameAxis( _a->GetYaxis(), _b->GetYaxis() ) && sameAxis( _a->GetZaxis(), _b->GetZaxis() );
+	}
+
+protected:
+	// the double sums so far become the starting point for TH1::Add
+	void switchToAdd( TH1 * _like ){
+		TDirectory::TContext ctx( nullptr );
+		if ( initialized ){
+			added = result( "accumulator_added" );
+		} else {
+			added = (TH1*)_like->Clone( "accumulator_added" );
+			added->SetDirectory( nullptr );
+			added->Reset();
+		}
+		if ( added->GetSumw2N() == 0 ) added->Sumw2();
+		LOG_F( INFO, "Summing %s with TH1::Add (profile or different binning)", _like->GetName() );
+	}
+
+	void init( TH1 * _h ){
+		TDirectory::TContext ctx( nullptr );
+		shape = (TH1*)_h->Clone( "accumulator_shape" );
+		shape->SetDirectory( nullptr );
+		shape->Reset();
+		size_t n = _h->GetNcells();
+		sum.assign( n, 0 ); comp.assign( n, 0 );
+		sumw2.assign( n, 0 ); comp2.assign( n, 0 );
+		stats.assign( TH1::kNstat, 0 ); statsComp.assign( TH1::kNstat, 0 );
+		initialized = true;
+	}
+
+	// Kahan-Babuska (Neumaier) summation when enabled, the compensation is kept separately
+	void accumulate( double &_sum, double &_comp, double _v ){
+		if ( false == kahan ){
+			_sum += _v;
+			return;
+		}
+		double t = _sum + _v;
+		if ( std::fabs( _sum ) >= std::fabs( _v ) )
+			_comp += ( _sum - t ) + _v;
+		else
+			_comp += ( _v - t ) + _sum;
+		_sum = t;
+	}
+
+	void addAll( const std::vector<Input> &_inputs, size_t _begin, size_t _end ){
+		TDirectory::TContext ctx( nullptr );
+		// only the file of the current input is open, merged sources have thousands
+		TFile * f = nullptr;
+		std::string url;
+		std::map<std::string, TH1*> buffers; // one per class
+		for ( size_t i = _begin; i < _end; i++ ){
+			const Input &in = _inputs[i];
+			if ( nullptr != in.h ){
+				add( in.h );
+				continue;
+			}
+
+			if ( in.url != url ){
+				closeFile( f );
+				url = in.url;
+				f = TFile::Open( url.c_str() );
+				if ( nullptr == f || f->IsZombie() )
+					LOG_F( ERROR, "Cannot open %s", url.c_str() );
+			}
+			if ( nullptr == f || f->IsZombie() ) continue;
+
+			// names may point into a sub-directory
+			TDirectory * dir = f;
+			std::string keyName = in.name;
+			if ( keyName.find( '/' ) != std::string::npos ){
+				dir = f->GetDirectory( keyName.substr( 0, keyName.find_last_of( '/' ) ).c_str() );
+				keyName = keyName.substr( keyName.find_last_of( '/' ) + 1 );
+			}
+			TKey * key = nullptr != dir ? dir->GetKey( keyName.c_str() ) : nullptr;
+			if ( nullptr == key ){
+				LOG_F( WARNING, "No %s in %s", in.name.c_str(), in.url.c_str() );
+				continue;
+			}
+			std::string cls = key->GetClassName();
+			// histograms register with the current directory while being read
+			TDirectory::TContext rctx( dir );
+			if ( buffers.count( cls ) == 0 ){
+				TH1 * h = dynamic_cast<TH1*>( key->ReadObj() );
+				if ( nullptr == h ){
+					LOG_F( WARNING, "%s is not a histogram", in.name.c_str() );
+					continue;
+				}
+				h->SetDirectory( nullptr );
+				buffers[ cls ] = h;
+			} else {
+				// stream into the existing object instead of allocating a new one
+				buffers[ cls ]->Reset();
+				key->Read( buffers[ cls ] );
+				buffers[ cls ]->SetDirectory( nullptr );
+			}
+			add( buffers[ cls ] );
+		}
+
+		for ( auto kv : buffers ) delete kv.second;
+		closeFile( f );
+	}
+
+	static void closeFile( TFile * &_f ){
+		if ( nullptr != _f ) _f->Close();
+		delete _f;
+		_f = nullptr;
+	}
+};
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef HISTO_PREFETCHER_H
+#define HISTO_PREFETCHER_H
+
+// STL
+#include <string>
+#include <map>
+#include <set>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// ROOT
+#include "TROOT.h"
+#include "TFile.h"
+#include "TH1.h"
+#include "TDirectory.h"
+
+// Project
+#include "loguru.h"
+
+/* Reads histograms on a background thread so that reading the
+ * objects needed by the next loop iterations overlaps with drawing
+ * the current one. The worker uses its own TFile handles, results
+ * are detached from any directory and owned by the caller of take()
+ */
+class HistoPrefetcher {
+protected:
+	std::thread worker;
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool running = false;
+	bool stopping = false;
+
+	std::deque< std::pair<std::string, std::string> > queue;
+	std::set<std::string> requested;
+	std::map<std::string, TH1*> results;
+	std::map<std::string, TFile*> handles;
+	size_t maxHandles = 8;
+
+public:
+	HistoPrefetcher() {}
+	~HistoPrefetcher() { stop(); }
+
+	static std::string key( const std::string &_url, const std::string &_name ) { return _url + "|" + _name; }
+
+	// returns false if the object was requested already (by someone else)
+	bool request( std::string _url, std::string _name ){
+		start();
+		std::string k = key( _url, _name );
+		{
+			std::lock_guard<std::mutex> lock( mtx );
+			if ( requested.count( k ) > 0 ) return false;
+			requested.insert( k );
+			queue.push_back( std::make_pair( _url, _name ) );
+		}
+		cv.notify_all();
+		return true;
+	}
+
+	// blocks until a requested object is read, returns nullptr if it was never requested or not found
+	TH1 * take( std::string _url, std::string _name ){
+		std::string k = key( _url, _name );
+		std::unique_lock<std::mutex> lock( mtx );
+		if ( requested.count( k ) == 0 ) return nullptr;
+		cv.wait( lock, [&]{ return results.count( k ) > 0; } );
+		TH1 * h = results[ k ];
+		results.erase( k );
+		requested.erase( k );
+		return h;
+	}
+
+	// drop only the given requests, pending or read, the others are kept
+	void drop( const std::set<std::string> &_keys ){
+		std::unique_lock<std::mutex> lock( mtx );
+		for ( auto it = queue.begin(); it != queue.end(); ){
+			std::string k = key( it->first, it->second );
+			if ( _keys.count( k ) > 0 ){
+				requested.erase( k );
+				it = queue.erase( it );
+			} else ++it;
+		}
+		// wait for the one being read
+		cv.wait( lock, [&]{
+			for ( const std::string &k : _keys )
+				if ( requested.count( k ) > 0 && results.count( k ) == 0 ) return false;
+			return true;
+		} );
+		for ( const std::string &k : _keys ){
+			if ( results.count( k ) > 0 ){
+				delete results[ k ];
+				results.erase( k );
+			}
+			requested.erase( k );
+		}
+	}
+
+	// drop pending requests and delete results nobody took
+	void clear(){
+		std::unique_lock<std::mutex> lock( mtx );
+		for ( auto &q : queue )
+			requested.erase( key( q.first, q.second ) );
+		queue.clear();
+		cv.wait( lock, [&]{ return requested.size() == results.size(); } );
+		for ( auto kv : results )
+			delete kv.second;
+		results.clear();
+		requested.clear();
+	}
+
+	void stop(){
+		if ( false == running ) return;
+		clear();
+		{
+			std::lock_guard<std::mutex> lock( mtx );
+			stopping = true;
+		}
+		cv.notify_all();
+		worker.join();
+		running = false;
+		stopping = false;
+	}
+
+protected:
+	void start(){
+		if ( running ) return;
+		ROOT::EnableThreadSafety();
+		running = true;
+		worker = std::thread( &HistoPrefetcher::work, this );
+	}
+
+	void work(){
+		while ( true ){
+			std::pair<std::string, std::string> item;
+			{
+				std::unique_lock<std::mutex> lock( mtx );
+				cv.wait( lock, [&]{ return stopping || queue.size() > 0; } );
+				if ( stopping ) break;
+				item = queue.front();
+				queue.pop_front();
+			}
+
+			TH1 * h = read( item.first, item.second );
+			{
+				std::lock_guard<std::mutex> lock( mtx );
+				results[ key( item.first, item.second ) ] = h;
+			}
+			cv.notify_all();
+		}
+
+		for ( auto kv : handles ){
+			kv.second->Close();
+			delete kv.second;
+		}
+		handles.clear();
+	}
+
+	TH1 * read( const std::string &_url, const std::string &_name ){
+		TDirectory::TContext ctx;
+		if ( handles.count( _url ) == 0 ){
+			if ( handles.size() >= maxHandles ){
+				handles.begin()->second->Close();
+				delete handles.begin()->second;
+				handles.erase( handles.begin() );
+			}
+			TFile * f = TFile::Open( _url.c_str() );
+			if ( nullptr == f || false == f->IsOpen() ){
+				delete f;
+				return nullptr;
+			}
+			handles[ _url ] = f;
+		}
+
+		TObject * obj = handles[ _url ]->Get( _name.c_str() );
+		TH1 * h = dynamic_cast<TH1*>( obj );
+		if ( nullptr == h ) return nullptr;
+		h->SetDirectory( nullptr );
+		return h;
+	}
+};
+
+#endif
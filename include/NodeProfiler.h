@@ -0,0 +1,196 @@
+#ifndef NODE_PROFILER_H
+#define NODE_PROFILER_H
+
+// STL
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+// ROOT
+#include "TSystem.h"
+#include "TFile.h"
+
+// Project
+#include "loguru.h"
+
+/* Records wall time, cpu time, RSS and bytes read for every node
+ * executed and writes them as Chrome trace-event JSON
+ * (chrome://tracing, speedscope, perfetto)
+ */
+class NodeProfiler {
+public:
+	struct Event {
+		std::string tag;
+		std::string path;
+		std::string loop;
+		double ts = 0;     // us since start
+		double wall = 0;   // us
+		double cpu = 0;    // us
+		long rss = 0;      // kB delta
+		long long bytes = 0;
+		int depth = 0;
+	};
+
+protected:
+	bool active = false;
+	std::string url;
+	std::chrono::steady_clock::time_point t0;
+	std::vector<Event> events;
+
+	struct Open {
+		size_t index;
+		std::chrono::steady_clock::time_point wall;
+		std::clock_t cpu;
+		long rss;
+		long long bytes;
+	};
+	std::vector<Open> stack;
+
+public:
+	// begin() now, end() when the scope is left, whichever way
+	class Span {
+	public:
+		Span( NodeProfiler &_p, std::string _tag, std::string _path, std::string _loop ) : p( _p ), on( _p.enabled() ) {
+			if ( on ) p.begin( _tag, _path, _loop );
+		}
+		~Span() { if ( on ) p.end(); }
+	protected:
+		NodeProfiler &p;
+		bool on;
+	};
+
+	// writes the trace and prints the summary when the scope is left, early returns included
+	class Report {
+	public:
+		Report( NodeProfiler &_p, std::ostream &_out ) : p( _p ), out( _out ) {}
+		~Report() {
+			if ( false == p.enabled() ) return;
+			p.write();
+			p.summary( out );
+		}
+	protected:
+		NodeProfiler &p;
+		std::ostream &out;
+	};
+
+	NodeProfiler() {}
+
+	bool enabled() const { return active; }
+
+	void enable( std::string _url ){
+		url = _url;
+		active = true;
+		t0 = std::chrono::steady_clock::now();
+		LOG_F( INFO, "Profiling to %s", url.c_str() );
+	}
+
+	void begin( std::string _tag, std::string _path, std::string _loop ){
+		if ( false == active ) return;
+		Event e;
+		e.tag = _tag;
+		e.path = _path;
+		e.loop = _loop;
+		e.depth = stack.size();
+		Open o;
+		o.index = events.size();
+		events.push_back( e );
+		o.rss = rss();
+		o.bytes = TFile::GetFileBytesRead();
+		o.cpu = std::clock();
+		o.wall = std::chrono::steady_clock::now();
+		events[ o.index ].ts = std::chrono::duration<double, std::micro>( o.wall - t0 ).count();
+		stack.push_back( o );
+	}
+
+	// an event that was measured elsewhere, e.g. before profiling was enabled
+	void record( std::string _tag, std::string _path, double _ts, double _wall, double _cpu ){
+		if ( false == active ) return;
+		Event e;
+		e.tag = _tag;
+		e.path = _path;
+		e.ts = _ts;
+		e.wall = _wall;
+		e.cpu = _cpu;
+		e.depth = stack.size();
+		events.push_back( e );
+	}
+
+	void end(){
+		if ( false == active || stack.size() == 0 ) return;
+		auto wall = std::chrono::steady_clock::now();
+		std::clock_t cpu = std::clock();
+		Open o = stack.back();
+		stack.pop_back();
+		Event &e = events[ o.index ];
+		e.wall = std::chrono::duration<double, std::micro>( wall - o.wall ).count();
+		e.cpu = 1e6 * (double)( cpu - o.cpu ) / CLOCKS_PER_SEC;
+		e.rss = rss() - o.rss;
+		e.bytes = TFile::GetFileBytesRead() - o.bytes;
+	}
+
+	void write(){
+		if ( false == active ) return;
+		std::ofstream fout( url.c_str() );
+		fout << "{\"traceEvents\":[" << std::endl;
+		for ( size_t i = 0; i < events.size(); i++ ){
+			const Event &e = events[i];
+			fout << "{\"name\":\"" << escape( e.tag ) << "\",\"cat\":\"exec\",\"ph\":\"X\",\"pid\":1,\"tid\":1";
+			fout << std::fixed << std::setprecision( 3 ) << ",\"ts\":" << e.ts << ",\"dur\":" << e.wall;
+			fout << ",\"args\":{\"path\":\"" << escape( e.path ) << "\",\"loop\":\"" << escape( e.loop ) << "\"";
+			fout << ",\"cpu_us\":" << e.cpu << ",\"rss_kb\":" << e.rss << ",\"bytes_read\":" << e.bytes << "}}";
+			if ( i + 1 < events.size() ) fout << ",";
+			fout << std::endl;
+		}
+		fout << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+		fout.close();
+		LOG_F( INFO, "Wrote %lu profile events to %s", events.size(), url.c_str() );
+	}
+
+	void summary( std::ostream &out ){
+		if ( false == active ) return;
+		struct Total { long n = 0; double wall = 0, cpu = 0; long rss = 0; long long bytes = 0; };
+		std::map<std::string, Total> totals;
+		for ( const Event &e : events ){
+			Total &t = totals[ e.tag ];
+			t.n++;
+			t.wall += e.wall;
+			t.cpu += e.cpu;
+			t.rss += e.rss;
+			t.bytes += e.bytes;
+		}
+
+		out << std::left << std::setw( 16 ) << "tag" << std::right << std::setw( 10 ) << "calls"
+			<< std::setw( 14 ) << "wall [ms]" << std::setw( 14 ) << "cpu [ms]"
+			<< std::setw( 14 ) << "rss [kB]" << std::setw( 16 ) << "read [bytes]" << std::endl;
+		for ( auto kv : totals ){
+			out << std::left << std::setw( 16 ) << kv.first << std::right << std::setw( 10 ) << kv.second.n
+				<< std::fixed << std::setprecision( 2 )
+				<< std::setw( 14 ) << kv.second.wall / 1000.0 << std::setw( 14 ) << kv.second.cpu / 1000.0
+				<< std::setw( 14 ) << kv.second.rss << std::setw( 16 ) << kv.second.bytes << std::endl;
+		}
+		out << "(times are inclusive of nested nodes)" << std::endl;
+	}
+
+protected:
+	long rss(){
+		ProcInfo_t pi;
+		gSystem->GetProcInfo( &pi );
+		return pi.fMemResident;
+	}
+
+	std::string escape( const std::string &in ){
+		std::string out;
+		for ( char c : in ){
+			if ( '"' == c || '\\' == c ) out += '\\';
+			out += c;
+		}
+		return out;
+	}
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef OBJECT_ARENA_H
+#define OBJECT_ARENA_H
+
+// STL
+#include <vector>
+#include <string>
+#include <utility>
+
+// ROOT
+#include "TObject.h"
+#include "TVirtualPad.h"
+#include "TCanvas.h"
+#include "TROOT.h"
+#include "TSeqCollection.h"
+
+// Project
+#include "loguru.h"
+
+/* Owns the frames, primitives and clones made while drawing a
+ * Plot, Pad or Canvas. Scopes nest, everything is deleted when the
+ * outermost scope closes (after its Exports), newest object first
+ */
+class ObjectArena {
+protected:
+	// the name of the canvas each object was drawn on, so it can be removed before deletion.
+	// Not the pointer, a new <TCanvas> of the same name deletes the old one
+	std::vector< std::pair<TObject*, std::string> > objects;
+	int depth = 0;
+
+public:
+	ObjectArena() {}
+	~ObjectArena() { release(); }
+
+	template <typename T>
+	T * own( T * _obj ){
+		if ( nullptr == _obj ) return _obj;
+		TVirtualPad * c = ( nullptr != gPad ) ? gPad->GetCanvas() : nullptr;
+		objects.push_back( std::make_pair( (TObject*)_obj, std::string( nullptr != c ? c->GetName() : "" ) ) );
+		return _obj;
+	}
+
+	void open() { depth++; }
+
+	// returns true if the outermost scope was closed and the objects were freed
+	bool close(){
+		if ( depth > 0 ) depth--;
+		if ( depth > 0 ) return false;
+		release();
+		return true;
+	}
+
+	size_t size() const { return objects.size(); }
+
+	void release(){
+		if ( objects.size() == 0 ) return;
+		DLOG_F( INFO, "Releasing %lu objects", objects.size() );
+		for ( auto it = objects.rbegin(); it != objects.rend(); ++it ){
+			TObject * c = "" != it->second ? gROOT->GetListOfCanvases()->FindObject( it->second.c_str() ) : nullptr;
+			if ( nullptr != c )
+				c->RecursiveRemove( it->first );
+			delete it->first;
+		}
+		objects.clear();
+	}
+};
+
+#endif
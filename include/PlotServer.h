@@ -0,0 +1,236 @@
+#ifndef PLOT_SERVER_H
+#define PLOT_SERVER_H
+
+// STL
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+
+// POSIX
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Project
+#include "loguru.h"
+
+/* Prefork server on a Unix domain socket. The parent binds the socket
+ * and forks workers that take turns accepting connections, pending
+ * connections wait in the listen backlog. A request is everything the
+ * client sends before shutting down its side of the connection, the
+ * reply is whatever the handler returns. Workers record their latencies
+ * in memory shared with the parent, so "STATS" reports all workers
+ * whichever one answers it. Workers that die are replaced
+ */
+class PlotServer {
+public:
+	typedef std::function<std::string( const std::string & )> Handler;
+
+	// latencies of the last requests of one worker in ms, written only by that worker
+	struct Latencies {
+		enum { capacity = 4096 };
+		int pid;
+		size_t nRequests;
+		double ms[ capacity ];
+	};
+
+protected:
+	std::string path;
+	int nWorkers = 1;
+	int backlog = 128;
+	int timeout = 30; // seconds a client may take to send its request
+	int fd = -1;
+	std::vector<pid_t> workers;
+	Latencies * shared = nullptr;
+
+	static volatile sig_atomic_t &stopping(){
+		static volatile sig_atomic_t s = 0;
+		return s;
+	}
+	static void onSignal( int ){ stopping() = 1; }
+
+public:
+	PlotServer( std::string _path, int _nWorkers = 1, int _backlog = 128, int _timeout = 30 )
+		: path( _path ), nWorkers( std::max( 1, _nWorkers ) ), backlog( _backlog ), timeout( _timeout ) {}
+	~PlotServer(){
+		if ( fd >= 0 ) ::close( fd );
+		if ( nullptr != shared ) munmap( shared, nWorkers * sizeof( Latencies ) );
+	}
+
+	bool listen(){
+		sockaddr_un addr;
+		memset( &addr, 0, sizeof( addr ) );
+		addr.sun_family = AF_UNIX;
+		if ( path.size() >= sizeof( addr.sun_path ) ){
+			LOG_F( ERROR, "Socket path %s is too long", path.c_str() );
+			return false;
+		}
+		strncpy( addr.sun_path, path.c_str(), sizeof( addr.sun_path ) - 1 );
+		::unlink( path.c_str() );
+
+		fd = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+		if ( fd < 0 || ::bind( fd, (sockaddr*)&addr, sizeof( addr ) ) < 0 || ::listen( fd, backlog ) < 0 ){
+			LOG_F( ERROR, "Cannot listen on %s: %s", path.c_str(), strerror( errno ) );
+			return false;
+		}
+		LOG_F( INFO, "Listening on %s with %d workers", path.c_str(), nWorkers );
+		return true;
+	}
+
+	// forks the workers and replaces them when they die, returns after SIGINT or SIGTERM
+	void serve( Handler _handle ){
+		struct sigaction sa;
+		memset( &sa, 0, sizeof( sa ) );
+		sa.sa_handler = &PlotServer::onSignal; // no SA_RESTART, accept and waitpid return on a signal
+		sigaction( SIGINT, &sa, nullptr );
+		sigaction( SIGTERM, &sa, nullptr );
+		signal( SIGPIPE, SIG_IGN );
+
+		// one latency ring per worker, kept by the parent across restarts
+		void * mem = mmap( nullptr, nWorkers * sizeof( Latencies ), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+		if ( MAP_FAILED == mem ){
+			LOG_F( ERROR, "Cannot map the shared latencies: %s", strerror( errno ) );
+			return;
+		}
+		shared = (Latencies*)mem;
+		memset( shared, 0, nWorkers * sizeof( Latencies ) );
+
+		workers.assign( nWorkers, -1 );
+		for ( int i = 0; i < nWorkers; i++ )
+			spawn( i, _handle );
+
+		while ( false == stopping() ){
+			int status = 0;
+			pid_t pid = waitpid( -1, &status, 0 );
+			if ( pid < 0 ){
+				if ( EINTR == errno ) continue;
+				break;
+			}
+			auto it = std::find( workers.begin(), workers.end(), pid );
+			if ( it == workers.end() || stopping() ) continue;
+			LOG_F( WARNING, "Worker %d (pid %d) exited with status %d, restarting it", (int)( it - workers.begin() ), pid, status );
+			spawn( it - workers.begin(), _handle );
+		}
+
+		for ( pid_t pid : workers )
+			if ( pid > 0 ) kill( pid, SIGTERM );
+		for ( pid_t pid : workers )
+			if ( pid > 0 ) waitpid( pid, nullptr, 0 );
+		::close( fd );
+		fd = -1;
+		::unlink( path.c_str() );
+		LOG_F( INFO, "Server on %s stopped", path.c_str() );
+	}
+
+protected:
+	void spawn( int _i, Handler &_handle ){
+		pid_t pid = fork();
+		if ( 0 == pid ){
+			work( _i, _handle );
+			_exit( 0 );
+		}
+		if ( pid < 0 )
+			LOG_F( ERROR, "Cannot fork worker %d: %s", _i, strerror( errno ) );
+		workers[ _i ] = pid;
+	}
+
+	void work( int _worker, Handler &_handle ){
+		shared[ _worker ].pid = (int)getpid();
+		while ( false == stopping() ){
+			int c = ::accept( fd, nullptr, nullptr );
+			if ( c < 0 ){
+				if ( EINTR == errno ) continue;
+				LOG_F( ERROR, "accept failed: %s", strerror( errno ) );
+				break;
+			}
+			auto start = std::chrono::steady_clock::now();
+			std::string request;
+			std::string reply;
+			if ( false == readAll( c, request, start + std::chrono::seconds( timeout ) ) )
+				reply = "ERROR timed out reading the request\n";
+			else if ( 0 == request.find( "STATS" ) )
+				reply = stats();
+			else
+				reply = _handle( request );
+			writeAll( c, reply );
+			::close( c );
+
+			double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+			Latencies &mine = shared[ _worker ];
+			mine.ms[ mine.nRequests % Latencies::capacity ] = ms;
+			mine.nRequests++;
+			LOG_F( INFO, "[worker %d] request %lu: %lu bytes in, %lu bytes out, %0.1f ms", _worker, mine.nRequests, request.size(), reply.size(), ms );
+		}
+	}
+
+	// percentiles over all workers, then one line per worker
+	std::string stats(){
+		auto line = [&]( std::string _label, std::vector<double> _ms, size_t _n ) -> std::string {
+			std::sort( _ms.begin(), _ms.end() );
+			auto pct = [&]( double q ) -> double {
+				if ( _ms.size() == 0 ) return 0;
+				return _ms[ std::min( _ms.size() - 1, (size_t)( q * _ms.size() ) ) ];
+			};
+			char buffer[ 256 ];
+			snprintf( buffer, sizeof( buffer ), "%s requests=%lu p50=%.1fms p90=%.1fms p99=%.1fms max=%.1fms\n",
+				_label.c_str(), _n, pct( 0.5 ), pct( 0.9 ), pct( 0.99 ), _ms.size() ? _ms.back() : 0.0 );
+			return buffer;
+		};
+
+		std::vector<double> all;
+		size_t nAll = 0;
+		std::string perWorker;
+		for ( int i = 0; i < nWorkers; i++ ){
+			const Latencies &l = shared[ i ];
+			size_t n = std::min( l.nRequests, (size_t)Latencies::capacity );
+			std::vector<double> ms( l.ms, l.ms + n );
+			all.insert( all.end(), ms.begin(), ms.end() );
+			nAll += l.nRequests;
+			perWorker += line( "worker=" + std::to_string( i ) + " pid=" + std::to_string( l.pid ), ms, l.nRequests );
+		}
+		return line( "all workers=" + std::to_string( nWorkers ), all, nAll ) + perWorker;
+	}
+
+	/* false if the client did not finish sending before _deadline. The
+	 * receive timeout is set to the time left before every read, so a client
+	 * dripping bytes cannot hold the worker past the deadline either
+	 */
+	static bool readAll( int _fd, std::string &_data, std::chrono::steady_clock::time_point _deadline ){
+		char chunk[ 65536 ];
+		while ( true ){
+			auto left = std::chrono::duration_cast<std::chrono::microseconds>( _deadline - std::chrono::steady_clock::now() ).count();
+			if ( left <= 0 ) return false;
+			timeval tv;
+			tv.tv_sec = left / 1000000;
+			tv.tv_usec = left % 1000000;
+			setsockopt( _fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( tv ) );
+
+			ssize_t n = ::read( _fd, chunk, sizeof( chunk ) );
+			if ( n < 0 && EINTR == errno ) continue;
+			if ( n < 0 && ( EAGAIN == errno || EWOULDBLOCK == errno ) ) return false;
+			if ( n <= 0 ) break;
+			_data.append( chunk, n );
+		}
+		return true;
+	}
+
+	static void writeAll( int _fd, const std::string &_data ){
+		size_t done = 0;
+		while ( done < _data.size() ){
+			ssize_t n = ::write( _fd, _data.data() + done, _data.size() - done );
+			if ( n < 0 && EINTR == errno ) continue;
+			if ( n <= 0 ) break;
+			done += n;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+// STL
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <cmath>
+#include <cstdint>
+
+/* KLL streaming quantile sketch (Karnin, Lang, Liberty 2016).
+ * Keeps O(k log(n/k)) values, the rank error is about 1.7/k.
+ * Values carry a weight, a compaction keeps one value of each adjacent
+ * pair (chosen with probability proportional to its weight) with the
+ * weight of both. Sketches filled on different threads can be merged
+ */
+class QuantileSketch {
+protected:
+	typedef std::pair<double, double> Item; // value, weight
+	int k = 200;
+	std::vector< std::vector<Item> > levels;
+	uint64_t n = 0;
+	double totalWeight = 0;
+	double vmin = std::numeric_limits<double>::max();
+	double vmax = std::numeric_limits<double>::lowest();
+	std::mt19937 rng;
+
+public:
+	QuantileSketch( int _k = 200, unsigned _seed = 42 ) : k( std::max( _k, 8 ) ), levels( 1 ), rng( _seed ) {}
+
+	uint64_t count() const { return n; }
+	double weight() const { return totalWeight; }
+	double minimum() const { return vmin; }
+	double maximum() const { return vmax; }
+
+	// values with a weight <= 0 are not counted
+	void add( double _v, double _w = 1.0 ){
+		if ( std::isnan( _v ) || !( _w > 0 ) ) return;
+		levels[0].push_back( Item( _v, _w ) );
+		n++;
+		totalWeight += _w;
+		vmin = std::min( vmin, _v );
+		vmax = std::max( vmax, _v );
+		if ( levels[0].size() >= capacity( 0 ) )
+			compress();
+	}
+
+	void merge( const QuantileSketch &_other ){
+		if ( _other.n == 0 ) return;
+		while ( levels.size() < _other.levels.size() )
+			levels.push_back( std::vector<Item>() );
+		for ( size_t h = 0; h < _other.levels.size(); h++ )
+			levels[h].insert( levels[h].end(), _other.levels[h].begin(), _other.levels[h].end() );
+		n += _other.n;
+		totalWeight += _other.totalWeight;
+		vmin = std::min( vmin, _other.vmin );
+		vmax = std::max( vmax, _other.vmax );
+		compress();
+	}
+
+	// value below which a fraction _q of the entries lie
+	double quantile( double _q ) const {
+		if ( n == 0 ) return 0;
+		if ( _q <= 0 ) return vmin;
+		if ( _q >= 1 ) return vmax;
+		std::vector<Item> weighted = sorted();
+		double total = 0;
+		for ( auto &p : weighted ) total += p.second;
+		double target = _q * total;
+		double cum = 0;
+		for ( auto &p : weighted ){
+			cum += p.second;
+			if ( cum >= target ) return p.first;
+		}
+		return vmax;
+	}
+
+	std::vector<double> quantiles( const std::vector<double> &_qs ) const {
+		std::vector<double> r;
+		for ( double q : _qs )
+			r.push_back( quantile( q ) );
+		return r;
+	}
+
+	// _n + 1 edges splitting the entries into _n groups of equal population, duplicates removed
+	std::vector<double> equalPopulationEdges( int _n ) const {
+		std::vector<double> edges;
+		for ( int i = 0; i <= _n; i++ ){
+			double e = quantile( (double)i / _n );
+			if ( edges.size() == 0 || e > edges.back() )
+				edges.push_back( e );
+		}
+		return edges;
+	}
+
+protected:
+	size_t capacity( size_t _h ) const {
+		size_t depth = levels.size() - _h - 1;
+		return std::max( (size_t)2, (size_t)std::ceil( k * std::pow( 2.0 / 3.0, (double)depth ) ) );
+	}
+
+	size_t size() const {
+		size_t s = 0;
+		for ( auto &l : levels ) s += l.size();
+		return s;
+	}
+
+	size_t totalCapacity() const {
+		size_t s = 0;
+		for ( size_t h = 0; h < levels.size(); h++ ) s += capacity( h );
+		return s;
+	}
+
+	// pairs of neighbouring values of a full level become one value with the weight of both
+	void compress(){
+		while ( size() >= totalCapacity() ){
+			for ( size_t h = 0; h < levels.size(); h++ ){
+				if ( levels[h].size() < capacity( h ) ) continue;
+				if ( h + 1 == levels.size() )
+					levels.push_back( std::vector<Item>() );
+				std::vector<Item> &level = levels[h];
+				std::sort( level.begin(), level.end() );
+				Item held;
+				bool odd = level.size() % 2 == 1;
+				if ( odd ){
+					held = level.back();
+					level.pop_back();
+				}
+				std::uniform_real_distribution<double> uniform( 0.0, 1.0 );
+				for ( size_t i = 0; i + 1 < level.size(); i += 2 ){
+					double w = level[i].second + level[i+1].second;
+					const Item &keep = uniform( rng ) * w < level[i].second ? level[i] : level[i+1];
+					levels[h + 1].push_back( Item( keep.first, w ) );
+				}
+				level.clear();
+				if ( odd ) level.push_back( held );
+				break;
+			}
+		}
+	}
+
+	std::vector<Item> sorted() const {
+		std::vector<Item> weighted;
+		for ( size_t h = 0; h < levels.size(); h++ )
+			weighted.insert( weighted.end(), levels[h].begin(), levels[h].end() );
+		std::sort( weighted.begin(), weighted.end() );
+		return weighted;
+	}
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef SELECTION_CACHE_H
+#define SELECTION_CACHE_H
+
+// STL
+#include <string>
+#include <functional>
+
+// ROOT
+#include "TChain.h"
+#include "TChainElement.h"
+#include "TEntryList.h"
+#include "TSystem.h"
+#include "TString.h"
+
+/* Keys, names and titles of cached selection entry lists. A list is only
+ * valid for the files it was built from, so the chain signature (name,
+ * size and mtime of every file, and its entries when the chain was built
+ * from a manifest) goes into the in-memory key and into the title of a
+ * list saved to disk, which is checked when it is loaded
+ */
+class SelectionCache {
+public:
+	// _entries only for chains whose files were added with their entries, others learn them while reading
+	static std::string signature( TChain * _chain, bool _entries = false ){
+		std::string sig = "";
+		if ( nullptr == _chain || nullptr == _chain->GetListOfFiles() )
+			return sig;
+
+		TIter next( _chain->GetListOfFiles() );
+		TObject * el = nullptr;
+		while ( (el = next()) ){
+			std::string fname = el->GetTitle();
+			FileStat_t fs;
+			sig += fname;
+			if ( 0 == gSystem->GetPathInfo( fname.c_str(), fs ) )
+				sig += ":" + std::to_string( fs.fSize ) + ":" + std::to_string( fs.fMtime );
+			// mtime has one second granularity, a rewrite within it rarely keeps the entries too
+			TChainElement * ce = dynamic_cast<TChainElement*>( el );
+			if ( _entries && nullptr != ce )
+				sig += ":" + std::to_string( ce->GetEntries() );
+			sig += ";";
+		}
+		return sig;
+	}
+
+	static std::string key( std::string _data, std::string _select, long _N, std::string _signature ){
+		return _data + "|" + _select + "|" + std::to_string( _N ) + "|" + hash( _signature );
+	}
+
+	// the name of the list in memory and in the sidecar file
+	static std::string name( std::string _key ){
+		return "elist_" + hash( _key );
+	}
+
+	static std::string title( std::string _select, std::string _signature ){
+		return _select + " @" + hash( _signature );
+	}
+
+	// a saved list is used only for the same selection on unchanged files
+	static bool matches( TEntryList * _elist, std::string _select, std::string _signature ){
+		return nullptr != _elist && title( _select, _signature ) == _elist->GetTitle();
+	}
+
+	static std::string hash( std::string _s ){
+		return TString::Format( "%zx", std::hash<std::string>()( _s ) ).Data();
+	}
+};
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef TREE_FORMULA_LOOP_H
+#define TREE_FORMULA_LOOP_H
+
+// STL
+#include <string>
+#include <vector>
+#include <thread>
+#include <limits>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+// ROOT
+#include "TROOT.h"
+#include "TChain.h"
+#include "TChainElement.h"
+#include "TTreeFormula.h"
+#include "TTreeFormulaManager.h"
+#include "TEntryList.h"
+#include "TDirectory.h"
+
+// Project
+#include "loguru.h"
+
+/* Evaluates a set of expressions for every entry of a chain without
+ * TTree::Draw, so that the values can be aggregated directly
+ * (no intermediate arrays or polymarkers). Like TTree::Draw, expressions
+ * over arrays visit every instance of the entry, synchronized by a
+ * TTreeFormulaManager. Instances where the selection is 0 are skipped,
+ * otherwise its value is passed as the weight.
+ * With nThreads > 1 the entry range is split and every worker reads
+ * through its own TChain over the same files. With an entry list only
+ * its entries are visited and the range counts entries of the list
+ */
+class TreeFormulaLoop {
+public:
+	// (worker index, values of the expressions, weight)
+	typedef std::function<void( int, const std::vector<double> &, double )> Visitor;
+
+protected:
+	TChain * chain = nullptr;
+	std::vector<std::string> expressions;
+	std::string selection;
+	TEntryList * elist = nullptr;
+
+public:
+	TreeFormulaLoop( TChain * _chain, std::vector<std::string> _expressions, std::string _selection = "", TEntryList * _elist = nullptr )
+		: chain( _chain ), expressions( _expressions ), selection( _selection ), elist( _elist ) {}
+
+	Long64_t entries( Long64_t _max = std::numeric_limits<Long64_t>::max() ){
+		if ( nullptr == chain ) return 0;
+		if ( nullptr != elist ) return std::min( elist->GetN(), _max );
+		return std::min( chain->GetEntries(), _max );
+	}
+
+	// returns the number of entries visited (selected or not)
+	Long64_t run( Visitor _visit, int _nThreads = 1, Long64_t _max = std::numeric_limits<Long64_t>::max() ){
+		Long64_t n = entries( _max );
+		if ( n <= 0 ) return 0;
+		if ( _nThreads <= 1 ){
+			TEntryList * previous = chain->GetEntryList();
+			chain->SetEntryList( elist );
+			Long64_t visited = loop( chain, 0, 0, n, _visit );
+			chain->SetEntryList( previous );
+			return visited;
+		}
+
+		ROOT::EnableThreadSafety();
+		std::vector<std::thread> workers;
+		std::vector<Long64_t> visited( _nThreads, 0 );
+		Long64_t step = ( n + _nThreads - 1 ) / _nThreads;
+		for ( int t = 0; t < _nThreads; t++ ){
+			Long64_t begin = t * step;
+			Long64_t end = std::min( n, begin + step );
+			if ( begin >= end ) break;
+			workers.push_back( std::thread( [this, t, begin, end, &visited, &_visit](){
+				TDirectory::TContext ctx( nullptr );
+				std::unique_ptr<TChain> own( copyChain() );
+				// SetEntryList modifies the list, every worker gets its own copy
+				std::unique_ptr<TEntryList> list( nullptr != elist ? (TEntryList*)elist->Clone() : nullptr );
+				own->SetEntryList( list.get() );
+				visited[ t ] = loop( own.get(), t, begin, end, _visit );
+				own->SetEntryList( nullptr );
+			} ) );
+		}
+		for ( auto &w : workers )
+			w.join();
+
+		Long64_t total = 0;
+		for ( Long64_t v : visited ) total += v;
+		return total;
+	}
+
+protected:
+	TChain * copyChain(){
+		TDirectory::TContext ctx( nullptr );
+		TChain * c = new TChain( chain->GetName() );
+		TIter next( chain->GetListOfFiles() );
+		TChainElement * el = nullptr;
+		while ( (el = (TChainElement*)next()) ){
+			// keep entry counts that are already known so the files are not opened up front
+			Long64_t ne = el->GetEntries();
+			if ( ne > 0 && ne < TTree::kMaxEntries )
+				c->Add( el->GetTitle(), ne );
+			else
+				c->Add( el->GetTitle() );
+		}
+		return c;
+	}
+
+	Long64_t loop( TChain * _chain, int _worker, Long64_t _begin, Long64_t _end, Visitor &_visit ){
+		TDirectory::TContext ctx( nullptr );
+		// one manager decides how many instances all formulas have, as in TSelectorDraw.
+		// It is deleted with the last of its formulas
+		TTreeFormulaManager * manager = new TTreeFormulaManager();
+		std::vector<TTreeFormula*> formulas;
+		for ( size_t i = 0; i < expressions.size(); i++ ){
+			formulas.push_back( new TTreeFormula( ( "tfl_" + std::to_string( i ) ).c_str(), expressions[i].c_str(), _chain ) );
+			manager->Add( formulas.back() );
+		}
+		TTreeFormula * select = nullptr;
+		if ( "" != selection ){
+			select = new TTreeFormula( "tfl_select", selection.c_str(), _chain );
+			manager->Add( select );
+		}
+		manager->Sync();
+
+		std::vector<double> values( expressions.size(), 0 );
+		std::vector<double> first( expressions.size(), 0 );
+		int treeNumber = -1;
+		Long64_t i = _begin;
+		for ( ; i < _end; i++ ){
+			// the i-th entry of the entry list if there is one
+			Long64_t entry = nullptr != _chain->GetEntryList() ? _chain->GetEntryNumber( i ) : i;
+			if ( entry < 0 || _chain->LoadTree( entry ) < 0 ) break;
+			if ( _chain->GetTreeNumber() != treeNumber ){
+				treeNumber = _chain->GetTreeNumber();
+				// updates the leaves of every formula of the manager
+				manager->UpdateFormulaLeaves();
+			}
+
+			int nData = manager->GetNdata();
+			if ( nData <= 0 ) continue;
+
+			// the first instance, a scalar selection decides for the whole entry
+			double w0 = nullptr != select ? select->EvalInstance( 0 ) : 1.0;
+			bool selectMultiple = nullptr != select && select->GetMultiplicity() != 0;
+			if ( 0 == w0 && false == selectMultiple ) continue;
+			for ( size_t k = 0; k < formulas.size(); k++ )
+				first[k] = formulas[k]->EvalInstance( 0 );
+			if ( 0 != w0 )
+				_visit( _worker, first, w0 );
+
+			// the other instances, scalars keep the value of the first
+			for ( int j = 1; j < nData; j++ ){
+				double w = selectMultiple ? select->EvalInstance( j ) : w0;
+				if ( 0 == w ) continue;
+				for ( size_t k = 0; k < formulas.size(); k++ )
+					values[k] = formulas[k]->GetMultiplicity() != 0 ? formulas[k]->EvalInstance( j ) : first[k];
+				_visit( _worker, values, w );
+			}
+		}
+
+		for ( TTreeFormula * f : formulas ) delete f;
+		delete select;
+		return i - _begin;
+	}
+};
+
+#endif
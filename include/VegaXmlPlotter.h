@@ -14,6 +14,7 @@ using namespace jdb;
 #include <vector>
 #include <memory>
 #include <string>
+#include <set>
 
 using namespace std;
 
@@ -21,6 +22,7 @@ using namespace std;
 #include "TCanvas.h"
 #include "TH1.h"
 #include "TChain.h"
+#include "TEntryList.h"
 #include "TPad.h"
 #include "TPaveStats.h"
 #include "TApplication.h"
@@ -38,12 +40,22 @@ using namespace std;
 
 // Handlers
 #include "TFMaker.h"
+#include "ChainManifest.h"
+#include "DataFilePool.h"
+#include "HistoPrefetcher.h"
+#include "NodeProfiler.h"
+#include "ExecutionPlan.h"
+#include "ObjectArena.h"
+#include "Downsample.h"
+#include "ExportSink.h"
+#include "SelectionCache.h"
 
 class VegaXmlPlotter : public TaskRunner
 {
 protected:
 	TFMaker makerTF;
 	bool initializedGROOT = false;
+	bool initializedGraphics = false;
 
 	typedef void (VegaXmlPlotter::*MFP)(string);
 	std::map <string, MFP> handle_map;
@@ -54,7 +66,43 @@ protected:
 	map<string, TF1*> funcs;
 	TH1 * current_frame = nullptr;
 
-	XmlCanvas * xcanvas;
+	XmlCanvas * xcanvas = nullptr;
+	// frames, primitives and clones made for the current Plot/Canvas
+	ObjectArena arena;
+	void releaseArena();
+
+	NodeProfiler profiler;
+	// "var=value" of the enclosing loops, innermost last
+	vector<string> loopState;
+
+	// an index of the config tree: path, tag and handler of every node, children of a node
+	// are contiguous. It only saves the tree walks and handler lookups, attributes are still
+	// read and interpolated from the config on every visit and loops run through their handler
+	struct Instruction {
+		string path;
+		string tag;
+		MFP fp = nullptr;
+		int firstChild = 0;
+		int nChildren = 0;
+	};
+	vector<Instruction> program;
+	map<string, int> programIndex;
+
+	// variables written inside a Loop iteration or Plot are restored when the frame is popped
+	struct VarFrame {
+		vector<string> names;
+		map<string, pair<bool, string> > previous;
+	};
+	vector<VarFrame> frames;
+
+	// --explain collects the plan instead of executing
+	bool explainMode = false;
+	ExecutionPlan plan;
+	set<string> plannedHistos;
+	// chains a Skim will make: name -> (source chain, output url)
+	map<string, pair<string, string> > plannedSkims;
+	pair<Long64_t, Long64_t> explainCost( string _data );
+	map<string, pair<Long64_t, Long64_t> > explainChainCost;
 
 
 public:
@@ -66,11 +114,39 @@ public:
 
 	virtual void init();
 	virtual void make();
+	// clears per-config state so that the next config can run in the same process
+	virtual void reset();
+	// the server forks workers from a plotter that already loaded the data
+	virtual void detachFiles();
+	virtual void warmUp();
+	// the <Data> of the current config stay the default for every later config
+	void shareData();
+
+	// destinations of Exports by sink spec ("file", "tar:<url>"), defaultSink is used when none is given
+	map<string, shared_ptr<ExportSink> > exportSinks;
+	shared_ptr<ExportSink> defaultSink;
+	ExportSink * sinkFor( string _spec );
+	void closeSinks();
+
+	virtual void compile();
+	virtual void run( const Instruction &_ins );
+	const Instruction * compiled( string _path );
+	vector<string> childPaths( string _path );
+	// the first child of _path with the given tag, "" if there is none
+	string childPath( string _path, string _tag );
+	string tagOf( string _path );
+
+	void pushFrame();
+	void popFrame();
+	void setVar( string _name, string _value );
 
 	virtual void exec_node( string _path );
 	virtual void exec_children( string _path );
 	virtual void exec_children( string _path, string tag_type );
 	virtual void exec_Loop( string _path );
+	virtual vector<string> prefetchTargets( string _path );
+	virtual void prefetchStates( string _path, string _var, string _indexName, const vector<string> &_states, int _i, int _nAhead, int &_requestedUpTo, const vector<string> &_targets, set<string> &_requested );
+	string interpolate( string _s, const map<string, string> &_vars );
 	virtual void exec_TCanvas( string _path );
 	virtual void exec_Data( string _path );
 	virtual void exec_Plot( string _path );
@@ -80,6 +156,8 @@ public:
 	virtual void exec_ExportConfig( string _path );
 	virtual void exec_StatBox( string _path );
 	virtual void exec_Histo( string _path );
+	TH2 * pixelProxy( string _path, TH1 * _h );
+	TGraph * graphProxy( string _path, TGraph * _g );
 	virtual void exec_Graph( string _path );
 	virtual void exec_TF1( string _path );
 	virtual void exec_TLine( string _path );
@@ -123,25 +201,70 @@ public:
 	virtual void exec_transform_Proof( string _path );
 	virtual void exec_transform_List( string _path );
     virtual void exec_transform_Fit( string _path );
+	virtual void exec_transform_Skim( string _path );
+	virtual void exec_transform_Quantiles( string _path );
 
 
 	virtual bool exec( string tag, string _path ){
 		bool e = handle_map.count( tag ) > 0;
 		if ( false == e ) return false;
+		return dispatch( tag, _path, handle_map[ tag ] );
+	}
+
+	bool dispatch( const string &tag, const string &_path, MFP fp ){
 		LOG_F( INFO, "exec( %s @ %s )", tag.c_str(), _path.c_str() );
-		MFP fp = handle_map[ tag ];
+		if ( explainMode )
+			return explain( tag, _path );
+		string loop = "";
+		if ( profiler.enabled() ){
+			for ( string ls : loopState )
+				loop += ( "" == loop ? "" : ", " ) + ls;
+		}
+		NodeProfiler::Span span( profiler, tag, _path, loop );
 		(this->*fp)( _path );
 		return true;
 	}
 
 
+	virtual bool explain( string tag, string _path );
+	virtual void explainTreePass( string tag, string _path, string _data, string _name );
+	virtual void explainLoad( string tag, string _path, string _data, string _name );
+
 	string random_string( size_t length );
 
 	virtual void inlineDataFile( string _path, TFile *f );
 
 	// shared_ptr<HistoBook> book;
-	map<string, TFile*> dataFiles;
+	// <Data> files are opened lazily through the pool, by url
+	map<string, string> dataUrls;
+	// names of the <Data> declared by the current config, defaults are only picked among these
+	set<string> configData;
+	// preloaded <Data> that configs may use without declaring them (the plot server)
+	set<string> sharedData;
+	set<string> visibleData();
+	DataFilePool dataPool;
+	HistoPrefetcher prefetcher;
 	map<string, TChain *> dataChains;
+	// how each chain was defined, a batch reuses chains with the same definition
+	map<string, string> chainDefinitions;
+	// <Data urls="..."/> sources and the sums made from them so far, keyed by data/name
+	map<string, vector<string> > mergedUrls;
+	map<string, TH1 *> mergedCache;
+	// selection cache mode and sidecar url per chain
+	map<string, string> chainSelectCache;
+	map<string, string> chainSelectCacheUrl;
+	// entry lists of surviving entries keyed by (chain, select, N)
+	map<string, TEntryList *> selectionCache;
+	// selections drawn once so far, their list is only built when they come again
+	set<string> selectionSeen;
+	// signature of the files of each chain, taken when it is loaded
+	map<string, string> chainSignatures;
+	// preview sampling: fraction per chain (<Data sample=""/>, else --preview), sample lists and their weight scale
+	map<string, double> chainSample;
+	map<string, TEntryList *> sampleCache;
+	map<string, double> sampleScale;
+	// per-file entries and cluster boundaries of each chain
+	map<string, ChainManifest> chainManifests;
 	map<string, TH1 * > globalHistos;
     map<string, TF1 * > globalTF1s;
 	map<string, TGraph * > globalGraphs;
@@ -149,15 +272,39 @@ public:
 	// bool initializedGROOT = false;
 
 	TFile * dataOut = nullptr;
+	// when objects in dataOut are written: "end", "per-plot" or "per-transform"
+	string outputFlush = "end";
+	virtual void flushOutput( bool _release );
+	void reportOutput();
 	virtual void loadDataFile( string _path );
+	virtual TFile* dataFile( string _name );
+	vector<string> expandUrls( string _spec );
+	virtual TH1* mergedHistogram( string _data, string _name );
 	virtual int numberOfData();
 	virtual void loadChain( string _path );
+	virtual void applyManifest( string _name, string _manifestUrl );
+	// a file kept next to the chain's list (list + _suffix) or next to its files (name + _suffix)
+	string sidecarUrl( string _url, string _name, string _suffix );
+	virtual void dropChain( string _name );
 	virtual void loadData();
+	// the data used when a node does not name one
+	string defaultData();
+	string defaultChain();
 
 	virtual TObject* findObject( string _data );
 	virtual TH1* findHistogram( string _data, string _name, string _path ="", int iHist=-1 );
 	virtual TH1* findHistogram( string _path, int iHist, string _mod="" );
 	virtual TH1* makeHistoFromDataTree( string _path, int iHist );
+	virtual TH1* makeDensityFromDataTree( string _path );
+	virtual void progressiveDraw( string _path, TChain * _chain, string _draw, string _hName, string _select, string _opt, Long64_t _N, TEntryList * _elist );
+	virtual TH1* makeQuantileBinnedHisto( string _path, string _data, string _name, string _title, int _nBins );
+	virtual TEntryList* selectionEntryList( string _data, string _select, long _N );
+	virtual void snapshot( string _path, string _hName, string _url );
+	double sampleFraction( string _data );
+	virtual TEntryList* sampleEntryList( string _data );
+	double previewScale( string _data, Long64_t _N );
+	virtual string chainSignature( string _data );
+	int compressionSettings( string _spec, int _default );
 	// virtual void positionOptStats( string _path, TPaveStats * st );
 
 	// virtual TCanvas* makeCanvas( string _path );
@@ -236,8 +383,11 @@ public:
 	}
 
 	bool typeMatch( TObject *obj, string type );
+	bool typeMatch( string objType, string type );
 	vector<string> glob( string query );
 	map<string, TObject*> dirMap( TDirectory *dir, string prefix ="", bool dive = true );
+	// name -> class of every key, without reading the objects
+	map<string, string> keyMap( TDirectory *dir, string prefix ="", bool dive = true );
 
 	string underscape( string in ){
 		std::replace( in.begin(), in.end(), '/', '_' );
@@ -245,6 +395,9 @@ public:
 	}
 
 	void setDefaultPalette();
+	// Cling and the style are only set up when a node first needs them
+	void interpreter();
+	void graphics();
 
 protected:
 	
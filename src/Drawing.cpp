@@ -35,6 +35,7 @@ void VegaXmlPlotter::exec_TCanvas( string _path ){
 	width = config.get<int>( _path + ":w", width );
 	height = config.get<int>( _path + ":h", height );
 
+	graphics();
 	TCanvas * c = nullptr; 
 	if ( width != -1 && height > -1 ){
 		c = new TCanvas( "c", "c", width, height );
@@ -75,11 +76,55 @@ void VegaXmlPlotter::exec_TFile( string _path ){
 	string url = config.getString( _path + ":url" );
 	LOG_F( INFO, "Opening %s in RECREATE mode", url.c_str() );
 	dataOut = new TFile( url.c_str(), "RECREATE" );
+	if ( config.exists( _path + ":compression" ) )
+		dataOut->SetCompressionSettings( compressionSettings( config.getXString( _path + ":compression" ), dataOut->GetCompressionSettings() ) );
+
+	// "end" (default), "per-plot" or "per-transform"
+	outputFlush = config.getXString( _path + ":flush", "end" );
+
+	// basket compression of trees written to the output runs on the ROOT thread pool
+	int nThreads = config.getInt( _path + ":threads", 0 );
+	if ( nThreads > 1 ){
+		ROOT::EnableImplicitMT( nThreads );
+		LOG_F( INFO, "Compressing tree baskets with %d threads", nThreads );
+	}
+	LOG_F( INFO, "Output compression=%d, flush=%s", dataOut->GetCompressionSettings(), outputFlush.c_str() );
 }
 
+void VegaXmlPlotter::flushOutput( bool _release ){
+	DSCOPE();
+	if ( nullptr == dataOut || false == dataOut->IsOpen() ) return;
+	TDirectory::TContext ctx( dataOut );
+
+	vector<TObject*> objs;
+	TIter next( dataOut->GetList() );
+	TObject * obj = nullptr;
+	while ( (obj = next()) ){
+		// trees manage their own baskets and are written at the end
+		if ( obj->InheritsFrom( "TTree" ) ) continue;
+		objs.push_back( obj );
+	}
+
+	set<TObject*> keep;
+	for ( auto kv : globalHistos ) keep.insert( kv.second );
+	for ( auto kv : globalGraphs ) keep.insert( kv.second );
+
+	for ( TObject * o : objs ){
+		int nb = dataOut->WriteTObject( o, o->GetName(), "Overwrite" );
+		DLOG( "Flushed %s (%d bytes)", o->GetName(), nb );
+		// results that later nodes can still use stay in memory
+		if ( _release && keep.count( o ) == 0 && o->InheritsFrom( "TH1" ) ){
+			((TH1*)o)->SetDirectory( nullptr );
+			delete o;
+		}
+	}
+	LOG_F( INFO, "Flushed %lu objects to %s", objs.size(), dataOut->GetName() );
+} // flushOutput
+
 void VegaXmlPlotter::exec_Script( string _path ){
 	DSCOPE();
 	vector<string> scripts = config.getStringVector( _path );
+	interpreter();
 	for ( string s : scripts ){
 		LOG_F( INFO, "gROOT->ProcessLine( \".L %s\" )", s.c_str() );
 		gROOT->ProcessLine( (".L " + s).c_str() );
@@ -89,6 +134,13 @@ void VegaXmlPlotter::exec_Script( string _path ){
 
 void VegaXmlPlotter::exec_children( string _path ){
 	DSCOPE();
+	const Instruction * ins = compiled( _path );
+	if ( nullptr != ins ){
+		for ( int i = ins->firstChild; i < ins->firstChild + ins->nChildren; i++ )
+			run( program[i] );
+		return;
+	}
+
 	vector<string> paths = config.childrenOf( _path, 1 );
 	for ( string p : paths ){
 		exec_node( p );
@@ -97,8 +149,17 @@ void VegaXmlPlotter::exec_children( string _path ){
 
 void VegaXmlPlotter::exec_children( string _path, string tag_type ){
 	DSCOPE();
-	vector<string> paths = config.childrenOf( _path, 1 );
 	DLOG( "exec children of %s, where tag = %s", _path.c_str(), tag_type.c_str() );
+	const Instruction * ins = compiled( _path );
+	if ( nullptr != ins ){
+		for ( int i = ins->firstChild; i < ins->firstChild + ins->nChildren; i++ ){
+			if ( tag_type == program[i].tag )
+				run( program[i] );
+		}
+		return;
+	}
+
+	vector<string> paths = config.childrenOf( _path, 1 );
 	for ( string p : paths ){
 		string tag = config.tagName( p );
 
@@ -230,14 +291,18 @@ void VegaXmlPlotter::exec_Loop( string _path ){
 			float va = bx.bins[i];
 			float vb = bx.bins[i+1];
 			// DLOG( "Executing range loop %s = %s", var.c_str(), state.c_str() );
-			config.set( vmin, ts(va) );
-			config.set( vmax, ts(vb) );
+			pushFrame();
+			setVar( vmin, ts(va) );
+			setVar( vmax, ts(vb) );
 
 			DLOG( "Executing Range Loop [%s = %d] (%s=%f, %s=%f)", indexName.c_str(), i, vmin.c_str(), va, vmax.c_str(), vb );
 
-			config.set( indexName, ts(i) );
+			setVar( indexName, ts(i) );
 
+			loopState.push_back( indexName + "=" + ts(i) );
 			exec_children( _path );
+			loopState.pop_back();
+			popFrame();
 		}
 		return;
 	}
@@ -264,22 +329,111 @@ void VegaXmlPlotter::exec_Loop( string _path ){
 		LOG_SCOPE_F( INFO, "Loop at %s", _path.c_str() );
 		int i = 0;
 		string indexName = config.get<string>( _path + ":index", var + "_i" );
+
+		// read the histograms of the next iterations in the background, explain reads nothing
+		int nAhead = explainMode ? 0 : config.getInt( _path + ":prefetch", config.getInt( "prefetch", 0 ) );
+		int requestedUpTo = 0;
+		vector<string> targets;
+		// what this loop asked for, nested loops share the prefetcher
+		set<string> requested;
+		if ( nAhead > 0 )
+			targets = prefetchTargets( _path );
+
 		for ( string state : states ){
 			DLOG( "Executing loop %s[%s = %d] = %s", var.c_str(), indexName.c_str(), i, state.c_str() );
 			string value = state;
-			config.set( var, value );
-			config.set( indexName, ts(i) );
+			pushFrame();
+			setVar( var, value );
+			setVar( indexName, ts(i) );
+			if ( nAhead > 0 && targets.size() > 0 )
+				prefetchStates( _path, var, indexName, states, i, nAhead, requestedUpTo, targets, requested );
 			// vector<string> paths = config.childrenOf( _path, 1 );
+			loopState.push_back( var + "=" + state );
 			exec_children( _path );
+			loopState.pop_back();
+			popFrame();
 			i++;
 		} // loop on states
+
+		if ( nAhead > 0 )
+			prefetcher.drop( requested );
 	}
 
 	
 
 } // exec_Loop
 
+vector<string> VegaXmlPlotter::prefetchTargets( string _path ){
+	DSCOPE();
+	// nodes below the loop that read a histogram by data/name
+	vector<string> tags = { "Histo", "Clone", "Scale", "Normalize", "Rebin", "Smooth", "CDF", "Sumw2", "Style", "Projection", "ProjectionX", "ProjectionY" };
+	vector<string> targets;
+	vector<string> paths = childPaths( _path );
+	for ( string p : paths ){
+		string tag = tagOf( p );
+		if ( std::find( tags.begin(), tags.end(), tag ) != tags.end() && config.exists( p + ":name" ) )
+			targets.push_back( p );
+		vector<string> sub = prefetchTargets( p );
+		targets.insert( targets.end(), sub.begin(), sub.end() );
+	}
+	return targets;
+} // prefetchTargets
+
+void VegaXmlPlotter::prefetchStates( string _path, string _var, string _indexName, const vector<string> &_states, int _i, int _nAhead, int &_requestedUpTo, const vector<string> &_targets, set<string> &_requested ){
+	DSCOPE();
+	int last = std::min( _i + _nAhead, (int)_states.size() - 1 );
+	if ( _requestedUpTo >= last )
+		return;
+
+	// interpolate the attributes with the loop variable set to the upcoming states,
+	// the config itself is not touched
+	for ( int j = std::max( _i + 1, _requestedUpTo + 1 ); j <= last; j++ ){
+		map<string, string> vars = { { _var, _states[j] }, { _indexName, ts(j) } };
+		for ( string p : _targets ){
+			string data = interpolate( config.getString( p + ":data" ), vars );
+			string name = interpolate( config.getString( p + ":name" ), vars );
+			if ( "" == data && name.find( "/" ) != string::npos ){
+				data = dataOnly( name );
+				name = nameOnly( name );
+			}
+			if ( "" == data )
+				data = defaultData();
+			if ( globalHistos.count( name ) > 0 || dataUrls.count( data ) == 0 )
+				continue;
+			DLOG( "Prefetching %s/%s for %s=%s", data.c_str(), name.c_str(), _var.c_str(), _states[j].c_str() );
+			if ( prefetcher.request( dataUrls[ data ], name ) )
+				_requested.insert( HistoPrefetcher::key( dataUrls[ data ], name ) );
+		}
+		_requestedUpTo = j;
+	}
+} // prefetchStates
+
+string VegaXmlPlotter::interpolate( string _s, const map<string, string> &_vars ){
+	// {name} is replaced by _vars[name], else by the config value of the same name
+	string out = "";
+	size_t pos = 0;
+	while ( pos < _s.size() ){
+		size_t open = _s.find( '{', pos );
+		size_t close = string::npos == open ? string::npos : _s.find( '}', open );
+		if ( string::npos == close ){
+			out += _s.substr( pos );
+			break;
+		}
+		string var = _s.substr( open + 1, close - open - 1 );
+		out += _s.substr( pos, open - pos );
+		if ( _vars.count( var ) > 0 )
+			out += _vars.find( var )->second;
+		else if ( config.exists( var ) )
+			out += config.getXString( var );
+		else
+			out += _s.substr( open, close - open + 1 );
+		pos = close + 1;
+	}
+	return out;
+} // interpolate
+
 void VegaXmlPlotter::exec_Palette( string _path ) {
+	graphics();
 	gStyle->SetPalette( config.getInt( _path ) );
 	if ( true == config.get<bool>( _path +":invert", false ) ){
 		TColor::InvertPalette();
@@ -294,7 +448,12 @@ void VegaXmlPlotter::exec_Plot( string _path ) {
 	graphs.clear();
 	funcs.clear();
 
-	exec_node( _path + ".Axes" );
+	graphics();
+	arena.open();
+	pushFrame();
+	string axes = childPath( _path, "Axes" );
+	if ( "" != axes )
+		exec_node( axes );
 
 	// if ( config.exists( _path + ".Palette" ) ){
 	// 	gStyle->SetPalette( config.getInt( _path + ".Palette" ) );
@@ -302,9 +461,9 @@ void VegaXmlPlotter::exec_Plot( string _path ) {
 
 	vector<string> tlp = { "Margins", "StatBox", "Scope", "Loop", "Histo", "Graph", "TF1", "TLine", "TLatex", "Rect", "Ellipse", "Assign", "Format", "Palette", "ColorAxis" };
 	vector<string> known_but_not_processed = { "Export", "Legend", "Axes" };
-	vector<string> paths = config.childrenOf( _path, 1 );
+	vector<string> paths = childPaths( _path );
 	for ( string p : paths ){
-		string tag = config.tagName( p );
+		string tag = tagOf( p );
 		if ( std::find( tlp.begin(), tlp.end(), tag ) != tlp.end() ){
 			exec_node( p );
 		} else {
@@ -321,8 +480,22 @@ void VegaXmlPlotter::exec_Plot( string _path ) {
 	exec_children( _path, "Legend" );
 	// Export the Plot if desired
 	exec_children( _path, "Export" );
+	popFrame();
+	releaseArena();
 } // exec_Plot
 
+void VegaXmlPlotter::releaseArena(){
+	// a Pad defers to its Canvas, only the outermost scope frees anything
+	if ( false == arena.close() ) return;
+	histos.clear();
+	graphs.clear();
+	funcs.clear();
+	current_frame = nullptr;
+
+	if ( "per-plot" == outputFlush )
+		flushOutput( true );
+} // releaseArena
+
 void VegaXmlPlotter::exec_Axes( string _path ){
 	DSCOPE();
 	
@@ -356,14 +529,14 @@ void VegaXmlPlotter::exec_Axes( string _path ){
 		return;
 	}
 
-	config.set( "x_min", dts(x.minimum()) );
-	config.set( "x_max", dts(x.maximum()) );
+	setVar( "x_min", dts(x.minimum()) );
+	setVar( "x_max", dts(x.maximum()) );
 
-	config.set( "y_min", dts(y.minimum()) );
-	config.set( "y_max", dts(y.maximum()) );
+	setVar( "y_min", dts(y.minimum()) );
+	setVar( "y_max", dts(y.maximum()) );
 
 
-	TH1 * frame = new TH1C( TString::Format( "frame_%s", random_string( 4 ).c_str()), "", x.nBins(), x.bins.data() );
+	TH1 * frame = arena.own( new TH1C( TString::Format( "frame_%s", random_string( 4 ).c_str()), "", x.nBins(), x.bins.data() ) );
 	frame->SetDirectory( 0 );
 
 	rpl.style( frame ).set( "yr", y.minimum(), y.maximum() );
@@ -371,7 +544,8 @@ void VegaXmlPlotter::exec_Axes( string _path ){
 
 	frame->SetMarkerStyle(8);
 	frame->SetMarkerSize(0);
-	frame->DrawClone("p");
+	// the arena owns the frame, draw it rather than a clone nobody frees
+	frame->Draw("p");
 
 	current_frame = (TH1C*)frame;
 } // exec_Axes
@@ -384,21 +558,86 @@ void VegaXmlPlotter::exec_Export( string _path ){
 	if ( !config.exists( _path + ":url" ) ) return;
 
 	string url = config.getXString( _path + ":url" );
-	if ( url.find( ".json" ) != string::npos ){
-#ifdef JSON_EXPORT
-		TBufferJSON::ExportToFile( url.c_str(), _pad );
-		
-		ofstream fout( url.c_str() );
-		fout << TBufferJSON::ConvertToJSON( _pad ).Data();
-		fout.close();
-#else
-		LOG_F( INFO, "JSON export requires compiling with libRIO" );
-#endif
+
+	// exports made from sampled data are marked as such
+	TLatex * watermark = nullptr;
+	if ( sampleScale.size() > 0 && nullptr != _pad ){
+		double f = 1.0;
+		for ( auto kv : sampleScale ) f = std::min( f, 1.0 / kv.second );
+		TLatex tl;
+		tl.SetTextColorAlpha( kRed, 0.6 );
+		tl.SetTextSize( 0.04 );
+		tl.SetTextAlign( 33 );
+		watermark = tl.DrawLatexNDC( 0.98, 0.98, TString::Format( "PREVIEW (%.2g%% sample)", 100 * f ) );
+	}
+
+	// sink="tar:figures.tar" (or exportSink for all Exports) instead of a file per Export
+	string sink = config.getXString( _path + ":sink", config.getXString( "exportSink", "" ) );
+	string ext = ExportSink::extension( url );
+	bool append = config.get<bool>( _path + ":append", false );
+	if ( append && "pdf" != ext && "ps" != ext ){
+		LOG_F( WARNING, "append only works for pdf and ps, exporting %s as a single file", url.c_str() );
+		append = false;
+	}
+
+	if ( nullptr == _pad ){
+		LOG_F( WARNING, "Nothing to export to %s", url.c_str() );
+	} else if ( append ){
+		// one page per Export, titled by the Plot it belongs to
+		string parent = _path.substr( 0, _path.find_last_of( '.' ) );
+		string title = config.getXString( _path + ":title", config.getXString( parent + ":name", config.getXString( parent + ":title", tagOf( parent ) ) ) );
+		PdfBookExportSink * book = dynamic_cast<PdfBookExportSink*>( sinkFor( "book:" + url ) );
+		ExportSink * target = sinkFor( sink );
+		if ( nullptr == book ){
+			LOG_F( ERROR, "Cannot append to %s", url.c_str() );
+		} else {
+			// the document goes where a single export would, only files are printed directly
+			if ( nullptr == dynamic_cast<FileExportSink*>( target ) )
+				book->deliverTo( target );
+			book->page( _pad, title );
+		}
 	} else {
-		_pad->Print( url.c_str() );
+		sinkFor( sink )->put( _pad, url );
+	}
+
+	if ( nullptr != watermark ){
+		_pad->GetListOfPrimitives()->Remove( watermark );
+		delete watermark;
 	}
 } // exec_Export
 
+ExportSink * VegaXmlPlotter::sinkFor( string _spec ){
+	if ( "" == _spec && defaultSink ) return defaultSink.get();
+	if ( "" == _spec ) _spec = "file";
+	if ( exportSinks.count( _spec ) > 0 ) return exportSinks[ _spec ].get();
+
+	if ( 0 == _spec.find( "book:" ) ){
+		// a single file per document, so close any other one that is still open
+		for ( auto kv : exportSinks )
+			if ( 0 == kv.first.find( "book:" ) ) kv.second->close();
+		exportSinks[ _spec ] = make_shared<PdfBookExportSink>( _spec.substr( 5 ) );
+		LOG_F( INFO, "Appending pages to %s", _spec.substr( 5 ).c_str() );
+	} else if ( 0 == _spec.find( "tar:" ) ){
+		exportSinks[ _spec ] = make_shared<TarExportSink>( _spec.substr( 4 ) );
+		LOG_F( INFO, "Appending exports to %s", _spec.substr( 4 ).c_str() );
+	} else {
+		if ( "file" != _spec )
+			LOG_F( WARNING, "Unknown export sink %s, writing files", _spec.c_str() );
+		exportSinks[ _spec ] = make_shared<FileExportSink>();
+	}
+	return exportSinks[ _spec ].get();
+} // sinkFor
+
+void VegaXmlPlotter::closeSinks(){
+	// documents first, they may be delivered to one of the other sinks
+	for ( auto kv : exportSinks )
+		if ( 0 == kv.first.find( "book:" ) ) kv.second->close();
+	for ( auto kv : exportSinks )
+		kv.second->close();
+	exportSinks.clear();
+	if ( defaultSink ) defaultSink->close();
+} // closeSinks
+
 
 void VegaXmlPlotter::exec_StatBox( string _path ){
 	DSCOPE();
@@ -450,7 +689,7 @@ void VegaXmlPlotter::exec_Histo( string _path ){
 		return;
 	}
 
-	config.set( "ClassName", h->ClassName() );
+	setVar( "ClassName", h->ClassName() );
 	DLOG( "ClassName %s", config[ "ClassName" ].c_str() );
 
 	
@@ -472,11 +711,20 @@ void VegaXmlPlotter::exec_Histo( string _path ){
 		rpl.style( h ).set( config, styleRef );
 	}
 
-	rpl.style( h ).set( config, _path ).set( config, _path + ".style" ).draw();
+	// a large TH2 is painted through a copy rebinned to the pad's resolution
+	TH1 * drawn = h;
+	TH2 * proxy = pixelProxy( _path, h );
+	if ( nullptr != proxy ){
+		rpl.style( h ).set( config, _path ).set( config, _path + ".style" );
+		drawn = arena.own( proxy );
+	}
+
+	rpl.style( drawn ).set( config, _path ).set( config, _path + ".style" ).draw();
 
 	if ( config.exists( _path +":after_draw" ) ){
 		string cmd = ".x " + config[_path+":after_draw"] + "( " + h->GetName() + " )";
 		LOG_F( INFO, "Executing: %s", cmd.c_str()  );
+		interpreter();
 		gROOT->ProcessLine( cmd.c_str() );
 	}
 
@@ -484,8 +732,8 @@ void VegaXmlPlotter::exec_Histo( string _path ){
 	std::transform(drawCommand.begin(), drawCommand.end(), drawCommand.begin(), ::tolower);
 	DLOG( "draw command = \"%s\"", drawCommand.c_str() );
 	if ( drawCommand.find( "same" ) == std::string::npos ){
-		LOG_F( INFO, "Setting current FRAME to %s ==> %s", fqn.c_str(), h->GetName() );
-		current_frame = h;
+		LOG_F( INFO, "Setting current FRAME to %s ==> %s", fqn.c_str(), drawn->GetName() );
+		current_frame = drawn;
 	}
 
 	//TPaveStats *st = (TPaveStats*)h->GetListOfFunctions()->FindObject("stats");
@@ -501,9 +749,44 @@ void VegaXmlPlotter::exec_Histo( string _path ){
 	histos[ nameOnly(fqn) ] = h;
 	histos[ fqn ] 			= h;
 
+	// histograms made for this Plot are freed with it, shared ones and those written to the output file are kept
+	bool shared = false;
+	for ( auto kv : globalHistos )
+		if ( kv.second == h ) shared = true;
+	if ( false == shared && ( nullptr == dataOut || h->GetDirectory() != dataOut ) )
+		arena.own( h );
+
 	// return h;
 } // exec_Histo
 
+TH2 * VegaXmlPlotter::pixelProxy( string _path, TH1 * _h ){
+	if ( nullptr == _h || 2 != _h->GetDimension() ) return nullptr;
+
+	string mode = Downsample::mode( config.getXString( _path + ":downsample", config.getString( "downsample", "" ) ), false );
+	if ( "" == mode ) return nullptr;
+	// bin labels drawn with "text" would change meaning
+	string drawOpt = config.getString( _path + ":draw" );
+	std::transform( drawOpt.begin(), drawOpt.end(), drawOpt.begin(), ::tolower );
+	if ( drawOpt.find( "text" ) != string::npos ) return nullptr;
+
+	int w = 0, h = 0;
+	if ( false == Downsample::framePixels( gPad, w, h ) ) return nullptr;
+	double oversample = config.getDouble( _path + ":oversample", config.getDouble( "oversample", 2.0 ) );
+	return Downsample::pixelProxy( (TH2*)_h, w, h, oversample, mode );
+} // pixelProxy
+
+TGraph * VegaXmlPlotter::graphProxy( string _path, TGraph * _g ){
+	if ( nullptr == _g ) return nullptr;
+
+	string mode = Downsample::mode( config.getXString( _path + ":downsample", config.getString( "downsample", "" ) ), true );
+	if ( "" == mode ) return nullptr;
+
+	int w = 0, h = 0;
+	if ( false == Downsample::framePixels( gPad, w, h ) ) return nullptr;
+	double oversample = config.getDouble( _path + ":oversample", config.getDouble( "oversample", 2.0 ) );
+	return Downsample::graphProxy( _g, w, oversample, mode );
+} // graphProxy
+
 void VegaXmlPlotter::exec_Graph( string _path ){
 	DSCOPE();
 	RooPlotLib rpl;
@@ -519,7 +802,7 @@ void VegaXmlPlotter::exec_Graph( string _path ){
 	LOG_F( INFO, "Found Graph at %s", _path.c_str() );
 
 	// set meta info
-	config.set( "ClassName", g->ClassName() );
+	setVar( "ClassName", g->ClassName() );
 
 	string name = config.getXString( _path + ":name" );
 	string data = config.getXString( _path + ":data" );
@@ -527,10 +810,25 @@ void VegaXmlPlotter::exec_Graph( string _path ){
 	string fqn = fullyQualifiedName( data, name );
 
 
-	rpl.style( g ).set( config, _path ).set( config, _path + ":style" ).set( config, _path + ".style" ).draw();
+	// a graph with many more points than pixels is drawn through a reduced copy
+	TGraph * drawn = g;
+	TGraph * proxy = graphProxy( _path, g );
+	if ( nullptr != proxy ){
+		rpl.style( g ).set( config, _path ).set( config, _path + ":style" ).set( config, _path + ".style" );
+		drawn = arena.own( proxy );
+	}
+
+	rpl.style( drawn ).set( config, _path ).set( config, _path + ":style" ).set( config, _path + ".style" ).draw();
 	graphs[ name ] = g;
 	graphs[ fqn ] = g;
 
+	// graphs read from a file are a new copy every time
+	bool shared = false;
+	for ( auto kv : globalGraphs )
+		if ( kv.second == g ) shared = true;
+	if ( false == shared )
+		arena.own( g );
+
 } // exec_Graph
 
 void VegaXmlPlotter::exec_TF1( string _path ){
@@ -549,14 +847,14 @@ void VegaXmlPlotter::exec_TF1( string _path ){
             LOG_F( ERROR, "Cannot make TF1 @ %s", _path.c_str() );
             return;
         }
-        f = (TF1*)f->Clone( (f->GetTitle() + string("_clone")).c_str() );
+        f = arena.own( (TF1*)f->Clone( (f->GetTitle() + string("_clone")).c_str() ) );
 
         
         LOG_F( INFO, "%s", f->GetTitle() );
         LOG_F( INFO, "Eval f(0)=%f", f->Eval( 1.0 ) );
 
         // set meta info
-        config.set( "ClassName", xf.getTF1()->ClassName() );
+        setVar( "ClassName", xf.getTF1()->ClassName() );
 
         string name = config.getXString( _path + ":name" );
         string data = config.getXString( _path + ":data" );
@@ -621,9 +919,9 @@ void VegaXmlPlotter::exec_TLine( string _path){
 	y[1] = config.getDouble( _path + ":y2", y[1] );
 
 	LOG_F( INFO, "Line (%0.2f, %0.2f)->(%0.2f, %0.2f)", x[0], y[0], x[1], y[1] );
-	TLine * line = new TLine( 
+	TLine * line = arena.own( new TLine( 
 		x[0], y[0],
-		x[1], y[1] );
+		x[1], y[1] ) );
 
 	line->SetLineColor( color( config.getString( _path + ":color" ) ) );
 	line->SetLineWidth( config.getInt( _path + ":width", 1 ) );
@@ -637,7 +935,7 @@ void VegaXmlPlotter::exec_Rect( string _path ){
 	vector<float> c;
 	c = config.getFloatVector( _path + ":pos" );
 	LOG_F( INFO, "Rect( %0.2f, %0.2f, %0.2f, %0.2f )", c[0], c[1], c[2], c[3] );
-	TBox * rect = new TBox( c[0], c[1], c[2], c[3] );
+	TBox * rect = arena.own( new TBox( c[0], c[1], c[2], c[3] ) );
 	RooPlotLib rpl;
 	rpl.style( rect ).set( config, _path );
 	rect->Draw();
@@ -654,7 +952,7 @@ void VegaXmlPlotter::exec_Ellipse( string _path ){
 	double ry = c[1];
 
 	LOG_F( INFO, "Ellipse( %0.2f, %0.2f, %0.2f, %0.2f )", x, y, rx, ry );
-	TEllipse * rect = new TEllipse( x, y, rx, ry );
+	TEllipse * rect = arena.own( new TEllipse( x, y, rx, ry ) );
 	RooPlotLib rpl;
 	rpl.style( rect ).set( config, _path );
 	rect->Draw();
@@ -797,7 +1095,8 @@ void VegaXmlPlotter::exec_TLegend( string _path ){
 			LOG_F( INFO, "Could not add Legend entry for name=%s", quote( name ).c_str() );
 			continue;
 		}
-		TH1 * h = (TH1*)histos[ name ]->Clone( ("hist_legend_" + name).c_str() );
+		TH1 * h = arena.own( (TH1*)histos[ name ]->Clone( ("hist_legend_" + name).c_str() ) );
+		h->SetDirectory( 0 );
 		
 		string t = config.getXString(  entryPath + ":title", name );
 		string opt = config.getXString(  entryPath + ":opt", "l" );
@@ -814,7 +1113,7 @@ void VegaXmlPlotter::exec_TLegend( string _path ){
 		string name = config.getXString( entryPath + ":name" );
 		if ( graphs.count( name ) <= 0 || graphs[ name ] == nullptr )
 			continue;
-		TGraph * g = (TGraph*)graphs[ name ]->Clone( ("graph_legend_" + name).c_str() );
+		TGraph * g = arena.own( (TGraph*)graphs[ name ]->Clone( ("graph_legend_" + name).c_str() ) );
 
 		string t = config.getXString(  entryPath + ":title", name );
 		string opt = config.getXString(  entryPath + ":opt", "l" );
@@ -831,7 +1130,7 @@ void VegaXmlPlotter::exec_TLegend( string _path ){
 		if ( funcs.count( name ) <= 0 || funcs[ name ] == nullptr ) {
 			continue;
 		}
-		TF1 * f = (TF1*)funcs[ name ]->Clone( ("func_legend_" + name).c_str() );
+		TF1 * f = arena.own( (TF1*)funcs[ name ]->Clone( ("func_legend_" + name).c_str() ) );
 
 		string t   = config.getXString(  entryPath + ":title", name );
 		string opt = config.getXString(  entryPath + ":opt", "l" );
@@ -865,6 +1164,8 @@ void VegaXmlPlotter::exec_TLegend( string _path ){
 			leg->SetFillStyle( config.getInt( attr[i] ) );
 	}
 
+	// owned after the entry clones so that it is deleted before them
+	arena.own( leg );
 	leg->Draw( );
 } // exec_TLegend
 
@@ -880,6 +1181,12 @@ void VegaXmlPlotter::exec_Clear( string _path ){
 void VegaXmlPlotter::exec_Canvas( string _path ){
 	DSCOPE();
 
+	if ( nullptr != xcanvas ){
+		delete xcanvas;
+		xcanvas = nullptr;
+	}
+	arena.open();
+	graphics();
 	xcanvas = new XmlCanvas( config, _path );
 	LOG_F( INFO, "Created ROOT Canvas = %p (name=%s)", (TPad*)xcanvas->rootCanvas, xcanvas->name.c_str() );
 	LOG_F( INFO, "Canvas with grid( ncol=%d, nrow=%d )", xcanvas->nCol, xcanvas->nRow );
@@ -889,6 +1196,7 @@ void VegaXmlPlotter::exec_Canvas( string _path ){
 	gPad->SetFillStyle(0);
 
 	exec_children( _path );
+	releaseArena();
 
 	// exec_children( _path, "Loop" );
 	// exec_children( _path, "Pad" );
@@ -6,13 +6,204 @@
 using namespace jdb;
 
 #include "VegaXmlPlotter.h"
+#include "PlotServer.h"
 
 #include "loguru.h"
 
+// STL
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+
+
+bool isList( string _arg ){
+	for ( string ext : { ".lis", ".txt" } )
+		if ( _arg.size() > ext.size() && 0 == _arg.compare( _arg.size() - ext.size(), ext.size(), ext ) )
+			return true;
+	return false;
+}
+
+// config urls (.xml or lists of them) and --key=value options
+void parseArgs( int argc, char* argv[], vector<string> &urls, map<string, string> &overrides ){
+	for ( int i = 1; i < argc; i++ ){
+		string arg = argv[i];
+		if ( "--batch" == arg ) continue;
+		if ( 0 == arg.find( "--" ) && arg.find( "=" ) != string::npos ){
+			overrides[ arg.substr( 2, arg.find( "=" ) - 2 ) ] = arg.substr( arg.find( "=" ) + 1 );
+			continue;
+		}
+		if ( 0 == arg.find( "-" ) ){
+			// other options (-v 9, ...) and the value that follows them
+			if ( i + 1 < argc && '-' != argv[i+1][0] && isList( argv[i+1] ) == false && string( argv[i+1] ).find( ".xml" ) == string::npos )
+				i++;
+			continue;
+		}
+
+		if ( arg.find( ".xml" ) != string::npos ){
+			urls.push_back( arg );
+			continue;
+		}
+		if ( false == isList( arg ) ){
+			LOG_F( WARNING, "Ignoring %s, configs are .xml files or .lis/.txt lists of them", arg.c_str() );
+			continue;
+		}
+		// a list with one config per line
+		ifstream list( arg.c_str() );
+		if ( false == list.good() ){
+			// reported as a failed config
+			urls.push_back( arg );
+			continue;
+		}
+		string line;
+		while ( getline( list, line ) ){
+			if ( line.size() == 0 || '#' == line[0] ) continue;
+			urls.push_back( line );
+		}
+	}
+}
+
+// counts the errors logged while a config runs
+void countErrors( void * _n, const loguru::Message & ){
+	(*(int*)_n)++;
+}
+
+// --batch config1.xml config2.xml ... or --batch configs.lis
+// runs every config in this process so that the data files, chains and
+// the interpreter are only set up once. A config fails if it cannot be
+// read or logs an error
+int runBatch( int argc, char* argv[] ){
+	vector<string> urls;
+	map<string, string> overrides;
+	parseArgs( argc, argv, urls, overrides );
+
+	LOG_F( INFO, "Batch of %lu configs", urls.size() );
+	VegaXmlPlotter plotter;
+	int nFailed = 0;
+	for ( size_t i = 0; i < urls.size(); i++ ){
+		auto start = chrono::steady_clock::now();
+		if ( false == ifstream( urls[i].c_str() ).good() ){
+			LOG_F( ERROR, "Cannot open %s", urls[i].c_str() );
+			nFailed++;
+			continue;
+		}
+		XmlConfig cfg;
+		cfg.loadFile( urls[i] );
+		if ( cfg.childrenOf( "" ).size() == 0 ){
+			LOG_F( ERROR, "%s is empty or not a valid config", urls[i].c_str() );
+			nFailed++;
+			continue;
+		}
+		for ( auto kv : overrides )
+			cfg.set( kv.first, kv.second );
+
+		int nErrors = 0;
+		loguru::add_callback( "batch_errors", countErrors, &nErrors, loguru::Verbosity_ERROR );
+		plotter.reset();
+		plotter.TaskRunner::init( cfg, "" );
+		plotter.run();
+		loguru::remove_callback( "batch_errors" );
+		if ( nErrors > 0 )
+			nFailed++;
+
+		double ms = chrono::duration<double, milli>( chrono::steady_clock::now() - start ).count();
+		LOG_F( INFO, "[%lu/%lu] %s %s in %0.1f ms", i + 1, urls.size(), urls[i].c_str(), nErrors > 0 ? "failed" : "done", ms );
+	}
+	if ( nFailed > 0 )
+		LOG_F( ERROR, "%d of %lu configs failed", nFailed, urls.size() );
+	return nFailed > 0 ? 1 : 0;
+}
+
+// requests only use the preloaded data and only export to the reply,
+// nothing they do may stay in the worker or land on the server's disk
+string refuseRequest( XmlConfig &cfg ){
+	if ( cfg.childrenOf( "", "Data" ).size() > 0 )
+		return "<Data> is not allowed, use the preloaded data by name";
+	if ( cfg.childrenOf( "", "TFile" ).size() > 0 )
+		return "<TFile> is not allowed";
+	if ( cfg.exists( "exportSink" ) )
+		return "exportSink is not allowed";
+	for ( string p : cfg.childrenOf( "", "Skim" ) )
+		if ( cfg.exists( p + ":url" ) )
+			return "<Skim url=\"\"> is not allowed";
+	for ( string p : cfg.childrenOf( "", "Export" ) )
+		if ( cfg.exists( p + ":sink" ) )
+			return "sink=\"\" is not allowed, exports are returned in the reply";
+	return "";
+}
+
+// --serve=/tmp/rbp.sock [--workers=4] [--timeout=30] [preload.xml]
+// loads the <Data> of the preload configs once, then forks workers that render
+// the XML configs sent to the socket and reply with the exported bytes:
+//   OK <number of exports> <render ms>\n then for every export <url> <size>\n<bytes>
+int runServer( int argc, char* argv[] ){
+	vector<string> urls;
+	map<string, string> overrides;
+	parseArgs( argc, argv, urls, overrides );
+	string socket = overrides[ "serve" ];
+	int nWorkers = overrides.count( "workers" ) > 0 ? atoi( overrides[ "workers" ].c_str() ) : 4;
+	int timeout = overrides.count( "timeout" ) > 0 ? atoi( overrides[ "timeout" ].c_str() ) : 30;
+	overrides.erase( "serve" );
+	overrides.erase( "workers" );
+	overrides.erase( "timeout" );
+
+	VegaXmlPlotter plotter;
+	for ( string url : urls ){
+		XmlConfig cfg;
+		cfg.loadFile( url );
+		plotter.reset();
+		plotter.TaskRunner::init( cfg, "" );
+		plotter.run();
+		plotter.shareData();
+	}
+	plotter.warmUp();
+	plotter.detachFiles();
+
+	// every worker keeps the exports of the current request in memory
+	shared_ptr<MemoryExportSink> memory = make_shared<MemoryExportSink>();
+	plotter.defaultSink = memory;
+
+	PlotServer server( socket, nWorkers, 128, timeout );
+	if ( false == server.listen() )
+		return 1;
+	server.serve( [&]( const string &_xml ) -> string {
+		auto start = chrono::steady_clock::now();
+		XmlConfig cfg;
+		cfg.loadXmlString( _xml );
+		if ( cfg.childrenOf( "" ).size() == 0 )
+			return "ERROR empty or invalid config\n";
+		string refused = refuseRequest( cfg );
+		if ( "" != refused )
+			return "ERROR " + refused + "\n";
+		for ( auto kv : overrides )
+			cfg.set( kv.first, kv.second );
+
+		plotter.reset();
+		memory->exports.clear();
+		plotter.TaskRunner::init( cfg, "" );
+		plotter.run();
+
+		double ms = chrono::duration<double, milli>( chrono::steady_clock::now() - start ).count();
+		string reply = "OK " + to_string( memory->exports.size() ) + " " + to_string( ms ) + "\n";
+		for ( auto &e : memory->exports )
+			reply += e.first + " " + to_string( e.second.size() ) + "\n" + e.second;
+		memory->exports.clear();
+		return reply;
+	} );
+	return 0;
+}
 
 int main( int argc, char* argv[] ) {
 
 	loguru::init(argc, argv);
+
+	for ( int i = 1; i < argc; i++ ){
+		if ( string( "--batch" ) == argv[i] )
+			return runBatch( argc, argv );
+		if ( 0 == string( argv[i] ).find( "--serve=" ) )
+			return runServer( argc, argv );
+	}
+
 	TaskFactory::registerTaskRunner<VegaXmlPlotter>( "VegaXmlPlotter" );
 	TaskEngine engine( argc, argv, "VegaXmlPlotter" );
 
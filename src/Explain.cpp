@@ -0,0 +1,221 @@
+#include "loguru.h"
+
+#include "VegaXmlPlotter.h"
+#include "Utils.h"
+
+#include "TKey.h"
+#include "TSystem.h"
+
+// nodes that only organize or repeat their children, these run normally in explain mode
+static const vector<string> explainStructural = { "Loop", "Scope", "RangeLoop", "Transforms", "Transform" };
+static const vector<string> explainContainers = { "Plot", "Pad", "Canvas" };
+static const vector<string> explainInterpreter = { "Script", "Assign", "Format", "ProcessLine" };
+static const vector<string> explainTransforms = { "Projection", "ProjectionX", "ProjectionY", "FitSlices", "MultiAdd", "Add", "Divide", "Difference", "Rebin", "Scale", "Normalize", "Clone", "Smooth", "CDF", "Style", "SetBinError", "BinLabels", "Sumw2", "Fit", "Quantiles" };
+
+static bool explainIn( const vector<string> &_list, const string &_tag ){
+	return std::find( _list.begin(), _list.end(), _tag ) != _list.end();
+}
+
+bool VegaXmlPlotter::explain( string tag, string _path ){
+	DSCOPE();
+
+	if ( explainIn( explainStructural, tag ) ){
+		MFP fp = handle_map[ tag ];
+		(this->*fp)( _path );
+		return true;
+	}
+
+	if ( explainIn( explainContainers, tag ) ){
+		plan.add( "plot", tag, _path, config.getXString( _path + ":name", "" ) );
+		exec_children( _path );
+		return true;
+	}
+
+	if ( explainIn( explainInterpreter, tag ) ){
+		plan.add( "interpreter", tag, _path, "values are not evaluated by --explain" );
+		return true;
+	}
+
+	if ( "Draw" == tag ){
+		explainTreePass( tag, _path, config.getXString( _path + ":data" ), config.getXString( _path + ":name" ) );
+		return true;
+	}
+
+	if ( "Skim" == tag ){
+		string source = config.getXString( _path + ":data" );
+		if ( "" == source )
+			source = defaultChain();
+		explainTreePass( tag, _path, source, config.getXString( _path + ":save_as" ) );
+		// later passes over the skim read its output, not the source
+		plannedSkims[ config.getXString( _path + ":save_as" ) ] = make_pair( source, config.getXString( _path + ":url" ) );
+		configData.insert( config.getXString( _path + ":save_as" ) );
+		return true;
+	}
+
+	if ( "Quantiles" == tag && config.exists( _path + ":draw" ) ){
+		explainTreePass( tag, _path, config.getXString( _path + ":data" ), config.getXString( _path + ":save_as" ) );
+		return true;
+	}
+
+	if ( "Histo" == tag || "Graph" == tag ){
+		explainLoad( tag, _path, config.getXString( _path + ":data" ), config.getXString( _path + ":name" ) );
+		return true;
+	}
+
+	if ( "Export" == tag ){
+		string url = config.getXString( _path + ":url" );
+		plan.add( "export", tag, _path, url, url );
+		return true;
+	}
+
+	if ( explainIn( explainTransforms, tag ) ){
+		string d = config.getXString( _path + ":data" );
+		vector<string> inputs;
+		if ( "MultiAdd" == tag || config.exists( _path + ":names" ) ){
+			inputs = config.getStringVector( _path + ":name" );
+			if ( inputs.size() < 1 )
+				inputs = config.getStringVector( _path + ":names" );
+		} else {
+			for ( string mod : { "", "A", "B", "num", "den" } ){
+				string n = config.getXString( _path + ":name" + mod, "" == mod ? "" : config.getXString( _path + ":" + mod ) );
+				if ( "" != n ) inputs.push_back( n );
+			}
+		}
+
+		for ( string n : inputs )
+			explainLoad( tag, _path, d, n );
+
+		string nn = config.getXString( _path + ":save_as" );
+		plan.add( "transform", tag, _path, ( "" != nn ? nn : "in place" ) );
+		if ( "" != nn )
+			plannedHistos.insert( nn );
+		return true;
+	}
+
+	// styling and decorations do not cost anything worth listing
+	return true;
+} // explain
+
+void VegaXmlPlotter::explainTreePass( string tag, string _path, string _data, string _name ){
+	DSCOPE();
+	if ( "" == _data && _name.find( "/" ) != string::npos ){
+		_data = dataOnly( _name );
+		_name = nameOnly( _name );
+	}
+	if ( "" == _data )
+		_data = defaultChain();
+
+	string draw   = config.getXString( _path + ":draw" );
+	string select = config.getXString( _path + ":select" );
+	string key = _data + "|" + draw + "|" + select + "|" + config.getXString( _path + ":bins_x" ) + "|" + config.getXString( _path + ":bins_y" ) + "|" + config.getXString( _path + ":N" );
+	if ( "Skim" == tag )
+		key = _data + "|skim|" + select + "|" + config.getXString( _path + ":branches" );
+
+	string what = _data + ": " + ( "Skim" == tag ? "skim" : draw ) + ( "" != select ? " [" + select + "]" : "" ) + " -> " + _name;
+	ExecutionPlan::Item &it = plan.add( "pass", tag, _path, what, key );
+
+	if ( dataChains.count( _data ) > 0 || plannedSkims.count( _data ) > 0 ){
+		pair<Long64_t, Long64_t> cost = explainCost( _data );
+		it.entries = cost.first;
+		it.bytes = cost.second;
+		if ( config.exists( _path + ":N" ) && it.entries >= 0 )
+			it.entries = std::min( it.entries, (Long64_t)config.get<long>( _path + ":N" ) );
+		if ( dataChains.count( _data ) == 0 )
+			it.what += " (skim of " + plannedSkims[ _data ].first + ")";
+	} else {
+		it.what += " (unknown chain)";
+	}
+	if ( "Skim" != tag )
+		plannedHistos.insert( nameOnly( _name ) );
+} // explainTreePass
+
+pair<Long64_t, Long64_t> VegaXmlPlotter::explainCost( string _data ){
+	DSCOPE();
+	if ( explainChainCost.count( _data ) > 0 )
+		return explainChainCost[ _data ];
+
+	pair<Long64_t, Long64_t> cost( -1, -1 );
+	if ( dataChains.count( _data ) > 0 && nullptr != dataChains[ _data ] ){
+		// entries and size on disk of every file of the chain
+		TChain * chain = dataChains[ _data ];
+		Long64_t bytes = 0;
+		TIter next( chain->GetListOfFiles() );
+		TObject * el = nullptr;
+		while ( (el = next()) ){
+			FileStat_t fs;
+			if ( 0 == gSystem->GetPathInfo( el->GetTitle(), fs ) )
+				bytes += fs.fSize;
+		}
+		cost = std::make_pair( chain->GetEntries(), bytes );
+	} else if ( plannedSkims.count( _data ) > 0 ){
+		// a skim already on disk is read like the executor reuses it, otherwise
+		// it has at most the entries of its source and is not bigger
+		string source = plannedSkims[ _data ].first;
+		string url = plannedSkims[ _data ].second;
+		cost = explainCost( source );
+		FileStat_t fs;
+		if ( dataChains.count( source ) > 0 && 0 == gSystem->GetPathInfo( url.c_str(), fs ) ){
+			TChain skim( dataChains[ source ]->GetName() );
+			skim.Add( url.c_str() );
+			cost = std::make_pair( skim.GetEntries(), (Long64_t)fs.fSize );
+		}
+	}
+	explainChainCost[ _data ] = cost;
+	return cost;
+} // explainCost
+
+void VegaXmlPlotter::explainLoad( string tag, string _path, string _data, string _name ){
+	DSCOPE();
+	if ( "" == _data && _name.find( "/" ) != string::npos ){
+		_data = dataOnly( _name );
+		_name = nameOnly( _name );
+	}
+
+	if ( plannedHistos.count( _name ) > 0 || globalHistos.count( _name ) > 0 ){
+		plan.add( "load", tag, _path, _name + " (memory)" );
+		return;
+	}
+
+	if ( "" == _data )
+		_data = defaultData();
+
+	if ( dataChains.count( _data ) > 0 || plannedSkims.count( _data ) > 0 ){
+		explainTreePass( tag, _path, _data, _name );
+		return;
+	}
+
+	ExecutionPlan::Item &it = plan.add( "load", tag, _path, fullyQualifiedName( _data, _name ), _data + "/" + _name );
+
+	// a merged source reads the object from every one of its files
+	if ( mergedUrls.count( _data ) > 0 ){
+		it.bytes = 0;
+		int nFound = 0;
+		for ( string url : mergedUrls[ _data ] ){
+			TFile * mf = dataPool.get( url );
+			TKey * key = nullptr != mf ? mf->GetKey( _name.c_str() ) : nullptr;
+			if ( nullptr == key ) continue;
+			it.bytes += key->GetNbytes();
+			nFound++;
+		}
+		it.what += " (merged from " + ts( nFound ) + " of " + ts( (int)mergedUrls[ _data ].size() ) + " files)";
+		return;
+	}
+
+	TFile * f = dataFile( _data );
+	if ( nullptr == f ){
+		it.what += " (unknown data)";
+		return;
+	}
+
+	TDirectory * dir = f;
+	string base = _name;
+	if ( _name.rfind( "/" ) != string::npos ){
+		dir = f->GetDirectory( _name.substr( 0, _name.rfind( "/" ) ).c_str() );
+		base = _name.substr( _name.rfind( "/" ) + 1 );
+	}
+	TKey * key = nullptr != dir ? dir->GetKey( base.c_str() ) : nullptr;
+	if ( nullptr != key )
+		it.bytes = key->GetNbytes();
+	else
+		it.what += " (not found)";
+} // explainLoad
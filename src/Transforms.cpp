@@ -12,6 +12,14 @@
 #include "TStyle.h"
 #include "TColor.h"
 #include "TTree.h"
+#include "TSystem.h"
+#include "TNamed.h"
+#include "TLeaf.h"
+#include "TBranch.h"
+
+#include "TreeFormulaLoop.h"
+#include "QuantileSketch.h"
+#include "HistoAccumulator.h"
 
 // #include "TBufferJSON.h"
 
@@ -22,6 +30,9 @@ void VegaXmlPlotter::exec_Transforms( string _path ){
 
 	// hmm
 	exec_Loop( _path );
+
+	if ( "per-transform" == outputFlush || "per-plot" == outputFlush )
+		flushOutput( false );
 }
 
 void VegaXmlPlotter::exec_transform_SetBinError( string _path ){
@@ -289,22 +300,66 @@ void VegaXmlPlotter::exec_transform_MultiAdd( string _path ){
 	// TODO allow modifier for each
 	// double mod = config.getDouble( _path + ":mod", 1.0 );
 
-	TH1 * hFirst = findHistogram( d, n[0] );
-	if ( nullptr == hFirst ){
-		LOG_F( ERROR, "Cannot find first histogram %s/%s", d.c_str(), n[0].c_str() );
+	// names (or a glob="" attribute) may contain wildcards, e.g. "TH1:hRun_*"
+	vector<string> queries = n;
+	for ( string g : config.getStringVector( _path + ":glob" ) )
+		queries.push_back( g );
+	vector<string> names;
+	for ( string q : queries ){
+		if ( q.find( "*" ) == string::npos ){
+			names.push_back( q );
+			continue;
+		}
+		vector<string> matches = glob( q );
+		names.insert( names.end(), matches.begin(), matches.end() );
+	}
+	if ( names.size() < 1 ){
+		LOG_F( ERROR, "No histograms to add for %s", nn.c_str() );
 		return;
 	}
-	TH1 * hSum = (TH1*)hFirst->Clone( nn.c_str() );
 
+	// histograms in data files are streamed by the accumulator instead of being cloned here
+	vector<HistoAccumulator::Input> inputs;
+	vector<TH1*> owned; // copies of merged sums, freed once added
+	for ( string name : names ){
+		string data = d;
+		string hn = name;
+		if ( "" == data && hn.find( "/" ) != string::npos && dataUrls.count( dataOnly( hn ) ) > 0 ){
+			data = dataOnly( hn );
+			hn = nameOnly( hn );
+		}
 
-	LOG_F( INFO, "Adding %lu Histograms", n.size() );
-	for ( int i = 1; i < n.size(); i++ ){
-		TH1 * h = findHistogram( d, n[i] );
-		if ( nullptr == h ) {
-			LOG_F( WARNING, "Cannot add n=(%s), nullptr", n[i].c_str() );
-			continue;
+		HistoAccumulator::Input in;
+		if ( globalHistos.count( hn ) > 0 && globalHistos[ hn ] ){
+			in.h = globalHistos[ hn ];
+		} else {
+			if ( "" == data )
+				data = defaultData();
+			if ( dataUrls.count( data ) > 0 ){
+				in.url = dataUrls[ data ];
+				in.name = hn;
+			} else {
+				in.h = findHistogram( data, hn );
+				if ( nullptr == in.h ) {
+					LOG_F( WARNING, "Cannot add n=(%s), nullptr", name.c_str() );
+					continue;
+				}
+				if ( mergedUrls.count( data ) > 0 )
+					owned.push_back( in.h );
+			}
 		}
-		hSum ->Add( h );
+		inputs.push_back( in );
+	}
+
+	int nThreads = std::max( 1, config.getInt( _path + ":threads", config.getInt( "threads", 1 ) ) );
+	bool kahan = config.getBool( _path + ":kahan", false );
+	LOG_F( INFO, "Adding %lu Histograms", inputs.size() );
+	TH1 * hSum = HistoAccumulator::sumAll( inputs, nn, nThreads, kahan );
+	for ( TH1 * h : owned )
+		delete h;
+	if ( nullptr == hSum ){
+		LOG_F( ERROR, "Cannot find first histogram %s/%s", d.c_str(), names[0].c_str() );
+		return;
 	}
 
 	globalHistos[nn] = hSum;
@@ -642,7 +697,11 @@ void VegaXmlPlotter::exec_transform_Draw( string _path ){
 
 	string d = config.getXString( _path + ":data" );
 	string nn = nameOnly( config.getXString( _path + ":name" ) );
-	TH1 * h = makeHistoFromDataTree( _path, 0 ); //findHistogram( _path, 0 );
+	TH1 * h = nullptr;
+	if ( "density" == config.getXString( _path + ":mode" ) )
+		h = makeDensityFromDataTree( _path );
+	else
+		h = makeHistoFromDataTree( _path, 0 ); //findHistogram( _path, 0 );
 	if ( nullptr == h ) {
 		LOG_F( ERROR, "Could not make %s", nn.c_str() );
 		return;
@@ -849,13 +908,7 @@ void VegaXmlPlotter::exec_transform_Assign( string _path ){
 	// store result of expression in sstr
 	// store result in the title of the TNamed
 	// 
-	if ( false == initializedGROOT ){
-		gROOT->ProcessLine( "#include \"sstream\" " );
-		initializedGROOT = true;
-		gROOT->ProcessLine( "std::stringstream sstr;" );
-		gROOT->ProcessLine( ("TNamed * tn = 0;") );
-		gROOT->ProcessLine( "TH1 * h = 0;" ) ;
-	}
+	interpreter();
 
 
 	if ( nullptr != h ){
@@ -937,12 +990,7 @@ void VegaXmlPlotter::exec_transform_Format( string _path ){
 	// store result of expression in sstr
 	// store result in the title of the TNamed
 	// 
-	if ( false == initializedGROOT ){
-		gROOT->ProcessLine( "#include \"sstream\" " );
-		initializedGROOT = true;
-		gROOT->ProcessLine( "std::stringstream sstr;" );
-		gROOT->ProcessLine( ("TNamed * tn = 0;") );
-	}
+	interpreter();
 
 	gROOT->ProcessLine( "sstr.str(\"\");" );
 	gROOT->ProcessLine( ("tn = new TNamed( \"" + varname + "\", \"tmp\" );").c_str() ) ;
@@ -978,6 +1026,7 @@ void VegaXmlPlotter::exec_transform_ProcessLine( string _path ){
 	}
 
 	string expr = config.getString( _path + ":expr" );
+	interpreter();
 	LOG_F( INFO, "gROOT->ProcessLine( \"%s\" )", expr.c_str() );
 	gROOT->ProcessLine( expr.c_str() );
 
@@ -989,8 +1038,10 @@ void VegaXmlPlotter::exec_transform_Proof( string _path ){
 	string data = config.get<string>( _path + ":data" );
 	bool on = config.get<bool>( _path + ":on", true );
 
-	if ( setup )
+	if ( setup ){
+		interpreter();
 		gROOT->ProcessLine( "TProof::Open( \"\" );" );
+	}
 
 	if ( dataChains.count( data ) >= 0 ){
 		dataChains[data]->SetProof( on );
@@ -1002,9 +1053,10 @@ void VegaXmlPlotter::exec_transform_List( string _path ){
 
 	string data = config.get<string>( _path + ":data" );
 
-	if ( dataFiles.count( data ) > 0 ){
+	TFile * f = dataFile( data );
+	if ( nullptr != f ){
 		LOG_F( INFO, "Listing data file: %s", data.c_str() );
-		dataFiles[ data ]->ls();
+		f->ls();
 	} else {
 		LOG_F( WARNING, "Data file name=%s NOT FOUND", data.c_str() );
 	}
@@ -1048,4 +1100,174 @@ void VegaXmlPlotter::exec_transform_Fit( string _path ){
     }
     
     globalTF1s[ nn ] = ff;
-}
\ No newline at end of file
+}
+
+void VegaXmlPlotter::exec_transform_Skim( string _path ){
+	DSCOPE();
+	if ( !config.exists( _path + ":save_as" ) || !config.exists( _path + ":url" ) ){
+		LOG_F( ERROR, "<Skim data select branches save_as url/> Must have a save_as and url attribute" );
+		return;
+	}
+
+	string data     = config.getXString( _path + ":data" );
+	string select   = config.getXString( _path + ":select" );
+	string nn       = config.getXString( _path + ":save_as" );
+	string url      = config.getXString( _path + ":url" );
+	vector<string> branches = config.getStringVector( _path + ":branches" );
+	long N = config.get<long>( _path + ":N", TTree::kMaxEntries );
+
+	if ( "" == data )
+		data = defaultChain();
+	if ( dataChains.count( data ) == 0 || nullptr == dataChains[ data ] ){
+		LOG_F( ERROR, "Skim source %s is not a chain", data.c_str() );
+		return;
+	}
+	TChain * chain = dataChains[ data ];
+	string treeName = chain->GetName();
+
+	// identifies the skim, if it matches the one stored in the cache file it is reused
+	string signature = select + "|";
+	for ( string b : branches )
+		signature += b + ",";
+	signature += "|" + std::to_string( N ) + "|" + chainSignature( data );
+
+	// like a <Data> chain, the skim belongs to this config and a batch reuses it if nothing changed
+	configData.insert( nn );
+	string definition = "skim|" + url + "|" + signature;
+	if ( nn != data && dataChains.count( nn ) > 0 && chainDefinitions[ nn ] == definition ){
+		LOG_F( INFO, "Reusing skim chain %s", nn.c_str() );
+		return;
+	}
+	// the old chain and its cached lists go, it may also still have the skim file open
+	if ( nn != data && dataChains.count( nn ) > 0 )
+		dropChain( nn );
+
+	TDirectory::TContext ctx( gDirectory );
+	bool reuse = false;
+	if ( false == gSystem->AccessPathName( url.c_str() ) && false == config.getBool( _path + ":force", false ) ){
+		TFile fcache( url.c_str() );
+		TNamed * meta = dynamic_cast<TNamed*>( fcache.Get( "skim_signature" ) );
+		if ( nullptr != meta && signature == meta->GetTitle() && nullptr != fcache.Get( treeName.c_str() ) )
+			reuse = true;
+		fcache.Close();
+	}
+
+	if ( reuse ){
+		LOG_F( INFO, "Reusing skim of %s from %s", data.c_str(), url.c_str() );
+	} else {
+		LOG_S(INFO) << "Skimming " << quote(data) << " with " << quote(select) << " into " << url;
+		TIter nextFile( chain->GetListOfFiles() );
+		TObject * el = nullptr;
+		while ( (el = nextFile()) ){
+			if ( url == el->GetTitle() ){
+				LOG_F( ERROR, "Cannot skim %s into %s, it is one of its files", data.c_str(), url.c_str() );
+				return;
+			}
+		}
+
+		if ( branches.size() > 0 ){
+			// the branches the selection reads are kept too, disabled they would read as 0
+			set<string> used;
+			if ( "" != select && chain->LoadTree( 0 ) >= 0 ){
+				TTreeFormula formula( "skim_select", select.c_str(), chain );
+				for ( int i = 0; i < formula.GetNcodes(); i++ )
+					if ( nullptr != formula.GetLeaf( i ) )
+						used.insert( formula.GetLeaf( i )->GetBranch()->GetName() );
+			}
+			chain->SetBranchStatus( "*", 0 );
+			for ( string b : branches )
+				chain->SetBranchStatus( b.c_str(), 1 );
+			for ( string b : used )
+				chain->SetBranchStatus( b.c_str(), 1 );
+		}
+
+		TFile * fout = new TFile( url.c_str(), "RECREATE" );
+		fout->SetCompressionSettings( compressionSettings( config.getXString( _path + ":compression", "lz4:4" ), ROOT::CompressionSettings( ROOT::kLZ4, 4 ) ) );
+		fout->cd();
+
+		TTree * skim = chain->CopyTree( select.c_str(), "", N );
+		if ( nullptr == skim ){
+			LOG_F( ERROR, "CopyTree failed for %s", data.c_str() );
+		} else {
+			LOG_F( INFO, "Skim kept %lld of %lld entries", skim->GetEntries(), chain->GetEntries() );
+			skim->Write();
+		}
+		TNamed meta( "skim_signature", signature.c_str() );
+		meta.Write();
+		fout->Close();
+		delete fout;
+
+		if ( branches.size() > 0 )
+			chain->SetBranchStatus( "*", 1 );
+	}
+
+	if ( dataChains.count( nn ) > 0 )
+		dropChain( nn );
+	chainDefinitions[ nn ] = definition;
+	dataChains[ nn ] = new TChain( treeName.c_str() );
+	dataChains[ nn ]->Add( url.c_str() );
+	chainSelectCache[ nn ] = "true";
+	LOG_S(INFO) << "Loaded TTree [name=" << quote(nn) << "] from skim: " << url;
+} // exec_transform_Skim
+
+void VegaXmlPlotter::exec_transform_Quantiles( string _path ){
+	DSCOPE();
+
+	string var = config.getXString( _path + ":save_as", config.getXString( _path + ":var" ) );
+	if ( "" == var ){
+		LOG_F( ERROR, "Quantiles needs save_as=\"var\" @ %s", _path.c_str() );
+		return;
+	}
+
+	vector<double> probs = config.getDoubleVector( _path + ":p" );
+	if ( probs.size() == 0 )
+		probs = { 0.05, 0.25, 0.5, 0.75, 0.95 };
+
+	vector<double> q( probs.size(), 0 );
+	string draw = config.getXString( _path + ":draw" );
+	if ( "" != draw ){
+		// straight from a tree with a streaming sketch, one pass and bounded memory
+		string data = config.getXString( _path + ":data" );
+		if ( "" == data )
+			data = defaultChain();
+		if ( dataChains.count( data ) == 0 || nullptr == dataChains[ data ] ){
+			LOG_F( ERROR, "Quantiles cannot find chain %s", quote(data).c_str() );
+			return;
+		}
+		Long64_t N = config.get<Long64_t>( _path + ":N", std::numeric_limits<Long64_t>::max() );
+		int nThreads = std::max( 1, config.getInt( _path + ":threads", config.getInt( "threads", 1 ) ) );
+		vector<QuantileSketch> sketches( nThreads, QuantileSketch( config.getInt( _path + ":k", 200 ) ) );
+		// the same entries as a plain Draw: selection list, else the preview sample
+		string select = config.getXString( _path + ":select" );
+		TEntryList * elist = nullptr;
+		if ( config.getBool( _path + ":entrylist", true ) )
+			elist = selectionEntryList( data, select, N );
+		if ( nullptr == elist )
+			elist = sampleEntryList( data );
+		TreeFormulaLoop tfl( dataChains[ data ], { draw }, select, elist );
+		// weighted by the select expression like Draw, a preview needs no scale for quantiles
+		tfl.run( [&]( int t, const vector<double> &v, double w ){
+			sketches[t].add( v[0], w );
+		}, nThreads, N );
+		for ( int t = 1; t < nThreads; t++ )
+			sketches[0].merge( sketches[t] );
+		q = sketches[0].quantiles( probs );
+		LOG_F( INFO, "Quantiles of %s from %llu entries", draw.c_str(), (unsigned long long)sketches[0].count() );
+	} else {
+		TH1 * h = findHistogram( _path, 0 );
+		if ( nullptr == h ){
+			LOG_F( ERROR, "Quantiles cannot find histogram @ %s", _path.c_str() );
+			return;
+		}
+		h->GetQuantiles( probs.size(), q.data(), probs.data() );
+	}
+
+	// var_0, var_1, ... and the full list in var
+	string all = "";
+	for ( size_t i = 0; i < q.size(); i++ ){
+		config.set( var + "_" + ts( (int)i ), dts( q[i] ) );
+		all += ( i > 0 ? ", " : "" ) + dts( q[i] );
+		LOG_F( INFO, "%s_%lu = %f (p=%f)", var.c_str(), i, q[i], probs[i] );
+	}
+	config.set( var, all );
+} // exec_transform_Quantiles
@@ -13,9 +13,26 @@
 #include "TStyle.h"
 #include "TColor.h"
 #include "TTree.h"
+#include "TSystem.h"
+#include "TROOT.h"
+#include "Compression.h"
+#include "TH2D.h"
+#include "TreeFormulaLoop.h"
+#include "QuantileSketch.h"
+#include "HistoAccumulator.h"
+#include "TRegexp.h"
+#include "TChainElement.h"
+
+#include <fstream>
+#include <chrono>
+#include <sstream>
 
 #include <thread>
 
+// as close to the start of the process as we get, after the shared libraries are loaded
+static const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+static bool startupRecorded = false;
+
 void VegaXmlPlotter::init(){
 	DSCOPE();
 	LOG_F( INFO, "VegaXmlPlotter Starting" );
@@ -27,7 +44,26 @@ void VegaXmlPlotter::init(){
 		LOG_F( INFO, "Not writing logfile");
 	}
 
-	setDefaultPalette();
+	dataPool.setCapacity( config.getInt( "maxOpenFiles", 128 ) );
+
+	explainMode = config.exists( "explain" );
+
+	if ( config.exists( "profile" ) )
+		profiler.enable( config.getString( "profile", "profile.json" ) );
+
+	// time spent before the first node, the interpreter and style are set up later on demand
+	if ( false == startupRecorded ){
+		startupRecorded = true;
+		double wall = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - processStart ).count();
+		ProcInfo_t pi;
+		gSystem->GetProcInfo( &pi );
+		double cpu = 1000.0 * ( pi.fCpuUser + pi.fCpuSys );
+		LOG_F( INFO, "Startup took %0.1f ms (%0.1f ms cpu since exec)", wall, cpu );
+		profiler.record( "Startup", "", 0, 1000.0 * wall, 1000.0 * cpu );
+		double budget = config.getDouble( "startupBudget", -1 );
+		if ( budget > 0 && cpu > budget )
+			LOG_F( WARNING, "Startup (%0.1f ms cpu) is over the budget of %0.1f ms", cpu, budget );
+	}
 
 	handle_map[ "TCanvas"      ] = &VegaXmlPlotter::exec_TCanvas;
 	handle_map[ "Data"         ] = &VegaXmlPlotter::exec_Data;
@@ -90,9 +126,97 @@ void VegaXmlPlotter::init(){
 	handle_map[ "Proof"        ] = &VegaXmlPlotter::exec_transform_Proof;
 	handle_map[ "List"         ] = &VegaXmlPlotter::exec_transform_List;
     handle_map[ "Fit"          ] = &VegaXmlPlotter::exec_transform_Fit;
+	handle_map[ "Skim"         ] = &VegaXmlPlotter::exec_transform_Skim;
+	handle_map[ "Quantiles"    ] = &VegaXmlPlotter::exec_transform_Quantiles;
 
 } // init
 
+void VegaXmlPlotter::reset(){
+	DSCOPE();
+	// per-config state, the data file pool, chains and caches are kept for the next config
+	arena.release();
+	histos.clear();
+	graphs.clear();
+	funcs.clear();
+	current_frame = nullptr;
+	frames.clear();
+	loopState.clear();
+	program.clear();
+	programIndex.clear();
+	plan = ExecutionPlan();
+	plannedHistos.clear();
+	plannedSkims.clear();
+	explainChainCost.clear();
+	outputFlush = "end";
+	prefetcher.clear();
+	configData.clear();
+	// filled again when this config uses a preview sample, marks its exports
+	sampleScale.clear();
+
+	// results of the previous config that are not owned by a file
+	set<TH1*> done;
+	for ( auto kv : globalHistos ){
+		TH1 * h = kv.second;
+		if ( nullptr == h || done.count( h ) > 0 ) continue;
+		done.insert( h );
+		if ( nullptr == h->GetDirectory() || gROOT == h->GetDirectory() )
+			delete h;
+	}
+	globalHistos.clear();
+	globalGraphs.clear();
+	globalTF1s.clear();
+
+	if ( nullptr != xcanvas ){
+		delete xcanvas;
+		xcanvas = nullptr;
+	}
+	closeSinks();
+} // reset
+
+void VegaXmlPlotter::detachFiles(){
+	DSCOPE();
+	// forked processes share the offsets of open descriptors, close everything
+	// before forking so that every worker opens the files again
+	prefetcher.stop();
+	dataPool.closeAll();
+	for ( auto &kv : dataChains ){
+		TChain * old = kv.second;
+		if ( nullptr == old || nullptr == old->GetFile() ) continue;
+		TDirectory::TContext ctx( nullptr );
+		TChain * c = new TChain( old->GetName() );
+		TIter next( old->GetListOfFiles() );
+		TChainElement * el = nullptr;
+		while ( (el = (TChainElement*)next()) ){
+			// entry counts are known already, the files are not opened again here
+			Long64_t ne = el->GetEntries();
+			if ( ne > 0 && ne < TTree::kMaxEntries )
+				c->Add( el->GetTitle(), ne );
+			else
+				c->Add( el->GetTitle() );
+		}
+		old->SetEntryList( nullptr );
+		delete old;
+		kv.second = c;
+	}
+} // detachFiles
+
+void VegaXmlPlotter::warmUp(){
+	DSCOPE();
+	auto start = std::chrono::steady_clock::now();
+	graphics();
+	interpreter();
+	// the first canvas and image pull in the graphics libraries
+	TDirectory::TContext ctx( nullptr );
+	TCanvas * c = new TCanvas( "warmup", "warmup", 100, 100 );
+	TImage * img = TImage::Create();
+	if ( nullptr != img ){
+		img->FromPad( c );
+		delete img;
+	}
+	delete c;
+	LOG_F( INFO, "Warmed up in %0.1f ms", std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+} // warmUp
+
 void VegaXmlPlotter::help(){
 	cout << "Allowed NODES : " << endl;
 	for ( auto kv : handle_map ){
@@ -100,8 +224,111 @@ void VegaXmlPlotter::help(){
 	}
 }
 
+void VegaXmlPlotter::compile(){
+	DSCOPE();
+	program.clear();
+	programIndex.clear();
+
+	// breadth first so that the children of every node end up next to each other
+	Instruction root;
+	root.path = "";
+	program.push_back( root );
+	for ( size_t i = 0; i < program.size(); i++ ){
+		vector<string> paths = config.childrenOf( program[i].path, 1 );
+		program[i].firstChild = program.size();
+		program[i].nChildren = paths.size();
+		for ( string p : paths ){
+			Instruction ins;
+			ins.path = p;
+			ins.tag = config.tagName( p );
+			if ( handle_map.count( ins.tag ) > 0 )
+				ins.fp = handle_map[ ins.tag ];
+			programIndex[ p ] = program.size();
+			program.push_back( ins );
+		}
+	}
+	LOG_F( INFO, "Compiled config into %lu instructions", program.size() );
+} // compile
+
+void VegaXmlPlotter::run( const Instruction &_ins ){
+	if ( nullptr == _ins.fp ){
+		LOG_F( ERROR, "No Handler for %s", _ins.tag.c_str() );
+		return;
+	}
+	dispatch( _ins.tag, _ins.path, _ins.fp );
+} // run
+
+const VegaXmlPlotter::Instruction * VegaXmlPlotter::compiled( string _path ){
+	if ( program.size() == 0 )
+		return nullptr;
+	if ( "" == _path )
+		return &program[0];
+	auto it = programIndex.find( _path );
+	if ( it == programIndex.end() )
+		return nullptr;
+	return &program[ it->second ];
+} // compiled
+
+vector<string> VegaXmlPlotter::childPaths( string _path ){
+	const Instruction * ins = compiled( _path );
+	if ( nullptr == ins )
+		return config.childrenOf( _path, 1 );
+
+	vector<string> paths;
+	for ( int i = ins->firstChild; i < ins->firstChild + ins->nChildren; i++ )
+		paths.push_back( program[i].path );
+	return paths;
+} // childPaths
+
+string VegaXmlPlotter::childPath( string _path, string _tag ){
+	for ( string p : childPaths( _path ) )
+		if ( _tag == tagOf( p ) )
+			return p;
+	return "";
+} // childPath
+
+string VegaXmlPlotter::tagOf( string _path ){
+	const Instruction * ins = compiled( _path );
+	if ( nullptr == ins )
+		return config.tagName( _path );
+	return ins->tag;
+} // tagOf
+
+void VegaXmlPlotter::pushFrame(){
+	frames.push_back( VarFrame() );
+} // pushFrame
+
+void VegaXmlPlotter::popFrame(){
+	if ( frames.size() == 0 ) return;
+	VarFrame &frame = frames.back();
+	for ( auto it = frame.names.rbegin(); it != frame.names.rend(); ++it ){
+		const pair<bool, string> &prev = frame.previous[ *it ];
+		if ( prev.first )
+			config.set( *it, prev.second );
+		else
+			config.deleteNode( *it );
+	}
+	frames.pop_back();
+} // popFrame
+
+void VegaXmlPlotter::setVar( string _name, string _value ){
+	// remember the value from before the frame the first time it is written
+	if ( frames.size() > 0 && frames.back().previous.count( _name ) == 0 ){
+		VarFrame &frame = frames.back();
+		frame.names.push_back( _name );
+		frame.previous[ _name ] = make_pair( config.exists( _name ), config.getString( _name ) );
+	}
+	config.set( _name, _value );
+} // setVar
+
 void VegaXmlPlotter::exec_node( string _path ){
 	DSCOPE();
+	const Instruction * ins = compiled( _path );
+	if ( nullptr != ins && "" != _path ){
+		run( *ins );
+		return;
+	}
+
 	if ( false == config.exists( _path ) )
 		return;
 
@@ -133,6 +360,8 @@ string VegaXmlPlotter::random_string( size_t length ){
 
 void VegaXmlPlotter::make(){
 	DSCOPE();
+	// the profile is written however make() ends
+	NodeProfiler::Report report( profiler, cout );
 
 	if (config.exists( "help" ) ){
 		help();
@@ -148,70 +377,129 @@ void VegaXmlPlotter::make(){
 
     vector<string> paths = config.childrenOf( "", "ExportConfig" );
 	for ( string p : paths ){
+		if ( explainMode ) break;
 		exec_node( p );
 	}
 
-	if ( dpaths.size() > 0 && dataFiles.size() == 0 && dataChains.size() == 0 ){
+	if ( dpaths.size() > 0 && numberOfData() == 0 ){
 		LOG_F( WARNING, "No valid data files found, exiting" );
 		return;
 	}
 
 	// if a TFile node is given for writing output, then execute it
-	exec_node( "TFile" );
+	if ( false == explainMode )
+		exec_node( "TFile" );
 
 	// if not global TCanvas tag exists then make a fallback canvas
-	if ( 0 == config.childrenOf( "", "TCanvas" ).size() ){
+	if ( false == explainMode && 0 == config.childrenOf( "", "TCanvas" ).size() ){
 		LOG_F( INFO, "No <TCanvas/> found at root, making a global TCanvas" );
 		exec_TCanvas( "" );
 	}
 
+	// the config is not modified structurally past this point
+	compile();
+
 	// Top level nodes
 	vector<string> tlp = { "Script", "TCanvas", "Margins", "Plot", "Loop", "RangeLoop", "Canvas", "Transforms", "Transform" };
 	vector<string> known_but_not_processed = { "Data", "arg", "argc", "jobIndex", "TFile" };
-	paths = config.childrenOf( "", 1 );
-	for ( string p : paths ){
-		string tag = config.tagName( p );
-		if ( std::find( tlp.begin(), tlp.end(), tag ) != tlp.end() ){
-			exec_node( p );
+	const Instruction &root = program[0];
+	for ( int i = root.firstChild; i < root.firstChild + root.nChildren; i++ ){
+		const Instruction &ins = program[i];
+		if ( std::find( tlp.begin(), tlp.end(), ins.tag ) != tlp.end() ){
+			run( ins );
 		} else {
-			if ( std::find( known_but_not_processed.begin(), known_but_not_processed.end(), tag ) == known_but_not_processed.end() ){
-				LOG_F( WARNING, "Found unrecognized node = %s, not processed here", tag.c_str() );
+			if ( std::find( known_but_not_processed.begin(), known_but_not_processed.end(), ins.tag ) == known_but_not_processed.end() ){
+				LOG_F( WARNING, "Found unrecognized node = %s, not processed here", ins.tag.c_str() );
 			}
 		}
 	}
 
+	if ( explainMode ){
+		plan.print( cout );
+		return;
+	}
+
+	// archives are finished once all Exports are done
+	closeSinks();
+
 	// Write data out if requested
 	if ( dataOut && dataOut->IsOpen() ){
-		dataOut->Write();
+		// objects flushed before are replaced instead of adding a second cycle
+		if ( "end" == outputFlush )
+			dataOut->Write();
+		else
+			dataOut->Write( nullptr, TObject::kOverwrite );
+		reportOutput();
+
+		// Close deletes everything attached to the file, forget those results
+		set<TObject*> attached;
+		TIter next( dataOut->GetList() );
+		TObject * obj = nullptr;
+		while ( (obj = next()) ) attached.insert( obj );
+		for ( auto it = globalHistos.begin(); it != globalHistos.end(); ){
+			if ( attached.count( it->second ) > 0 ) it = globalHistos.erase( it );
+			else ++it;
+		}
+
 		dataOut->Close();
 		LOG_F( INFO, "Write to %s completed", config.getString( "TFile:url" ).c_str() );
+		delete dataOut;
+		dataOut = nullptr;
 	}
 } // make
 
 void VegaXmlPlotter::loadDataFile( string _path ){
 	DSCOPE();
-	if ( config.exists( _path + ":name" ) && config.exists( _path + ":url" )  ){
+	if ( config.exists( _path + ":name" ) && config.exists( _path + ":urls" ) ){
+		// many files behaving as one, same-named histograms are summed on first use
+		string name = config.getXString( _path+":name" );
+		if ( false == config.getBool( _path + ":merge", true ) )
+			LOG_F( WARNING, "Data[%s]: urls are always merged", name.c_str() );
+		vector<string> urls = expandUrls( config.getXString( _path + ":urls" ) );
+		if ( urls.size() == 0 ){
+			LOG_F( ERROR, "Data[%s]: no files match %s", name.c_str(), config.getXString( _path + ":urls" ).c_str() );
+			return;
+		}
+		// sums made from a different file set are stale
+		if ( mergedUrls.count( name ) > 0 && mergedUrls[ name ] != urls ){
+			for ( auto it = mergedCache.begin(); it != mergedCache.end(); ){
+				if ( 0 == it->first.find( name + "/" ) ){
+					delete it->second;
+					it = mergedCache.erase( it );
+				} else ++it;
+			}
+		}
+		mergedUrls[ name ] = urls;
+		configData.insert( name );
+		LOG_F( INFO, "Data[%s] = %lu merged files", name.c_str(), urls.size() );
+
+	} else if ( config.exists( _path + ":name" ) && config.exists( _path + ":url" )  ){
 		string name = config.getXString( _path+":name" );
 		string url = config.getXString( _path+":url" );
 
 		DLOG( "Data[%s] = %s", name.c_str(), url.c_str() );
 		// LOG_S( INFO ) <<  "Data name=" << name << " @ " << url ;
 
-		TFile * f = new TFile( url.c_str() );
-		if ( false == f->IsOpen() ){
+		// the file is opened on first use, only check that a local file exists
+		if ( url.find( "://" ) == string::npos && gSystem->AccessPathName( url.c_str() ) ){
 			LOG_F( ERROR, "%s cannot be opened", url.c_str() );
 			return;
 		}
 
-		dataFiles[ name ] = f;
+		dataUrls[ name ] = url;
+		configData.insert( name );
 		LOG_F( INFO, "Data[%s] = %s", name.c_str(), url.c_str() );
 
-		if ( config.getBool( _path + ":inline", false ) )
-			inlineDataFile( _path, f );
+		if ( config.getBool( _path + ":inline", false ) ){
+			TFile * f = dataFile( name );
+			if ( nullptr != f )
+				inlineDataFile( _path, f );
+		}
 
 	} else if ( config.exists( _path + ":name" ) ){
 		string name = config.getXString( _path+":name" );
 		string fname = "tmp_" + name + ".root";
+		TDirectory::TContext ctx;
 		TFile *f = new TFile( fname.c_str(), "RECREATE" );
 		f->cd();
 		vector<string> paths = config.childrenOf( _path, "HistogramData" );
@@ -220,8 +508,11 @@ void VegaXmlPlotter::loadDataFile( string _path ){
 			TH1 * _h = XmlHistogram::fromXml( config, p );
 			_h->Write();
 			LOG_F( INFO, "Making %s = %p", p.c_str(), _h );
-			dataFiles[ name ] = f;
+			dataUrls[ name ] = fname;
+			configData.insert( name );
 		}
+		f->Close();
+		delete f;
 	}
 } // loadDataFiles
 
@@ -254,11 +545,102 @@ void VegaXmlPlotter::inlineDataFile( string _path, TFile *_f ){
 	// LOG_F( INFO, "resulting XML to inline : \n%s", xml.c_str() );
 } // inlineDataFile
 
+void VegaXmlPlotter::reportOutput(){
+	if ( nullptr == dataOut ) return;
+	Long64_t total = 0, totalRaw = 0;
+	TIter next( dataOut->GetListOfKeys() );
+	TKey * key = nullptr;
+	while ( (key = (TKey*)next()) ){
+		LOG_F( INFO, "  %-32s %-12s %10d bytes (%d uncompressed)", key->GetName(), key->GetClassName(), key->GetNbytes(), key->GetObjlen() );
+		total += key->GetNbytes();
+		totalRaw += key->GetObjlen();
+	}
+	LOG_F( INFO, "Wrote %d objects, %lld bytes (%lld uncompressed) to %s", dataOut->GetListOfKeys()->GetSize(), total, totalRaw, dataOut->GetName() );
+} // reportOutput
+
 int VegaXmlPlotter::numberOfData() {
 	DSCOPE();
-	return dataFiles.size() + dataChains.size();
+	// sources of earlier configs in a batch do not count
+	return visibleData().size();
 } // numberOfData
 
+vector<string> VegaXmlPlotter::expandUrls( string _spec ){
+	DSCOPE();
+	vector<string> urls;
+	std::stringstream ss( _spec );
+	string item;
+	while ( std::getline( ss, item, ',' ) ){
+		item.erase( 0, item.find_first_not_of( " \t" ) );
+		item.erase( item.find_last_not_of( " \t" ) + 1 );
+		if ( "" == item ) continue;
+		string ext = item.size() > 4 ? item.substr( item.size() - 4 ) : "";
+		if ( ".lis" == ext || ".txt" == ext ){
+			// one file per line
+			ifstream fin( item.c_str() );
+			string line;
+			while ( std::getline( fin, line ) ){
+				line.erase( 0, line.find_first_not_of( " \t" ) );
+				line.erase( line.find_last_not_of( " \t\r" ) + 1 );
+				if ( "" == line || '#' == line[0] ) continue;
+				urls.push_back( line );
+			}
+		} else if ( item.find_first_of( "*?" ) != string::npos ){
+			// wildcard in the file name
+			size_t slash = item.find_last_of( '/' );
+			string dir = slash == string::npos ? "." : item.substr( 0, slash );
+			string pattern = slash == string::npos ? item : item.substr( slash + 1 );
+			TRegexp re( pattern.c_str(), kTRUE );
+			vector<string> matches;
+			void * dirp = gSystem->OpenDirectory( dir.c_str() );
+			const char * entry = nullptr;
+			while ( dirp && ( entry = gSystem->GetDirEntry( dirp ) ) ){
+				TString e( entry );
+				Ssiz_t len = 0;
+				if ( re.Index( e, &len ) == 0 && len == e.Length() )
+					matches.push_back( slash == string::npos ? string( entry ) : dir + "/" + entry );
+			}
+			if ( dirp ) gSystem->FreeDirectory( dirp );
+			std::sort( matches.begin(), matches.end() );
+			urls.insert( urls.end(), matches.begin(), matches.end() );
+		} else {
+			urls.push_back( item );
+		}
+	}
+	return urls;
+} // expandUrls
+
+TH1* VegaXmlPlotter::mergedHistogram( string _data, string _name ){
+	DSCOPE();
+	if ( mergedUrls.count( _data ) == 0 ) return nullptr;
+
+	string key = _data + "/" + _name;
+	if ( mergedCache.count( key ) == 0 ){
+		vector<HistoAccumulator::Input> inputs;
+		for ( string url : mergedUrls[ _data ] ){
+			HistoAccumulator::Input in;
+			in.url = url;
+			in.name = _name;
+			inputs.push_back( in );
+		}
+		// every worker has one of the files open at a time, not its whole share
+		int nThreads = std::max( 1, config.getInt( "threads", (int)std::thread::hardware_concurrency() ) );
+		TDirectory::TContext ctx( nullptr );
+		// profiles and inputs with other axes are combined with TH1::Add, like hadd
+		mergedCache[ key ] = HistoAccumulator::sumAll( inputs, "merged_" + underscape( key ), nThreads );
+	}
+
+	TH1 * h = mergedCache[ key ];
+	if ( nullptr == h ) return nullptr;
+	// callers may scale or restyle what they get, the cached sum is never handed out
+	return (TH1*)h->Clone( ( "hist_" + _name ).c_str() );
+} // mergedHistogram
+
+TFile* VegaXmlPlotter::dataFile( string _name ){
+	if ( dataUrls.count( _name ) == 0 )
+		return nullptr;
+	return dataPool.get( dataUrls[ _name ] );
+} // dataFile
+
 void VegaXmlPlotter::loadChain( string _path ){
 	DSCOPE();
 	string name     = config.getXString( _path + ":name" );
@@ -268,7 +650,23 @@ void VegaXmlPlotter::loadChain( string _path ){
 	int index       = config.getInt( _path + ":index", -1 );
 	int splitBy     = config.getInt( _path + ":splitBy", 50 );
 
+	// in a batch the chain of a previous config is reused if it is defined the same way
+	configData.insert( name );
+	string definition = treeName + "|" + url + "|" + ts( maxFiles ) + "|" + ts( index ) + "|" + ts( splitBy ) + "|" + config.getXString( _path + ":manifest", "false" ) + "|" + config.getXString( _path + ":sample", "" );
+	if ( dataChains.count( name ) > 0 && chainDefinitions[ name ] == definition ){
+		LOG_F( INFO, "Reusing chain %s", name.c_str() );
+		// the files may have been rewritten since the last config
+		chainSignatures.erase( name );
+		chainSignature( name );
+		return;
+	}
+	if ( dataChains.count( name ) > 0 )
+		dropChain( name );
+	chainDefinitions[ name ] = definition;
+
 	dataChains[ name ] = new TChain( treeName.c_str() );
+	if ( config.exists( _path + ":sample" ) )
+		chainSample[ name ] = config.getDouble( _path + ":sample" );
 	
 	if ( url.find( ".lis" ) != std::string::npos ){
 		if ( index >= 0 ){
@@ -279,12 +677,104 @@ void VegaXmlPlotter::loadChain( string _path ){
 	} else 
 		ChainLoader::load( dataChains[ name ], url, maxFiles );
 	LOG_S(INFO) << "Loaded TTree [name=" << quote(name) << "] from url: " << url;
+
+	// manifest="true" stores per-file entries next to the list, or give a path
+	string manifest = config.getXString( _path + ":manifest", "false" );
+	if ( "false" != manifest && "0" != manifest ){
+		if ( "true" == manifest || "1" == manifest )
+			manifest = sidecarUrl( url, name, ".manifest.xml" );
+		applyManifest( name, manifest );
+	}
+
 	int nFiles = 0;
 	if ( dataChains[name]->GetListOfFiles() )
 		nFiles = dataChains[name]->GetListOfFiles()->GetEntries();
 	LOG_S(INFO) << "Chain has " << nFiles << plural( nFiles, " file", " files" );
+	chainSignature( name );
+
+	// selections are cached as entry lists in memory once they are used a second time
+	// selectCache="disk" builds them right away and persists them next to the chain files
+	string selectCache = config.getXString( _path + ":selectCache", "true" );
+	chainSelectCache[ name ] = selectCache;
+	if ( "disk" == selectCache ){
+		chainSelectCacheUrl[ name ] = config.getXString( _path + ":selectCacheUrl", sidecarUrl( url, name, ".elist.root" ) );
+		LOG_F( INFO, "Selection cache for %s @ %s", name.c_str(), chainSelectCacheUrl[ name ].c_str() );
+	}
 } // loadChain
 
+string VegaXmlPlotter::sidecarUrl( string _url, string _name, string _suffix ){
+	if ( _url.find( ".lis" ) != std::string::npos )
+		return _url + _suffix;
+	return _url.substr( 0, _url.find_last_of( '/' ) + 1 ) + _name + _suffix;
+} // sidecarUrl
+
+void VegaXmlPlotter::dropChain( string _name ){
+	DSCOPE();
+	// cached entry lists belong to the old chain
+	if ( dataChains.count( _name ) > 0 && dataChains[ _name ] )
+		dataChains[ _name ]->SetEntryList( nullptr );
+	string prefix = _name + "|";
+	for ( auto *cache : { &selectionCache, &sampleCache } ){
+		for ( auto it = cache->begin(); it != cache->end(); ){
+			if ( 0 == it->first.find( prefix ) ){
+				delete it->second;
+				it = cache->erase( it );
+			} else ++it;
+		}
+	}
+	for ( auto it = sampleScale.begin(); it != sampleScale.end(); ){
+		if ( 0 == it->first.find( prefix ) ) it = sampleScale.erase( it );
+		else ++it;
+	}
+	for ( auto it = selectionSeen.begin(); it != selectionSeen.end(); ){
+		if ( 0 == it->find( prefix ) ) it = selectionSeen.erase( it );
+		else ++it;
+	}
+	chainSample.erase( _name );
+	chainSelectCache.erase( _name );
+	chainSelectCacheUrl.erase( _name );
+	chainManifests.erase( _name );
+	chainSignatures.erase( _name );
+	delete dataChains[ _name ];
+	dataChains.erase( _name );
+} // dropChain
+
+void VegaXmlPlotter::applyManifest( string _name, string _manifestUrl ){
+	DSCOPE();
+	TChain * chain = dataChains[ _name ];
+	if ( nullptr == chain || nullptr == chain->GetListOfFiles() )
+		return;
+
+	ChainManifest &manifest = chainManifests[ _name ];
+	manifest.load( _manifestUrl );
+
+	// rebuild the chain with known entry counts so files are not opened until read
+	string treeName = chain->GetName();
+	TChain * mchain = new TChain( treeName.c_str() );
+	Long64_t nEntries = 0;
+	int nDropped = 0;
+	TIter next( chain->GetListOfFiles() );
+	TObject * el = nullptr;
+	while ( (el = next()) ){
+		string fname = el->GetTitle();
+		ChainManifest::Entry e = manifest.get( fname, treeName );
+		if ( e.entries <= 0 ){
+			LOG_F( WARNING, "Dropping %s from chain %s: %s", fname.c_str(), _name.c_str(), e.entries < 0 ? "cannot be read" : "no entries" );
+			nDropped++;
+			continue;
+		}
+		mchain->Add( fname.c_str(), e.entries );
+		nEntries += e.entries;
+	}
+	manifest.save();
+	if ( nDropped > 0 )
+		LOG_F( WARNING, "%d of %d files of chain %s were dropped", nDropped, nDropped + (int)mchain->GetListOfFiles()->GetEntries(), _name.c_str() );
+
+	delete chain;
+	dataChains[ _name ] = mchain;
+	LOG_F( INFO, "Chain %s has %lld entries from manifest %s", _name.c_str(), nEntries, _manifestUrl.c_str() );
+} // applyManifest
+
 void VegaXmlPlotter::loadData(){
 	DSCOPE();
 	vector<string> data_nodes = config.childrenOf( nodePath, "Data" );
@@ -303,6 +793,39 @@ void VegaXmlPlotter::loadData(){
 	}
 } // loadData
 
+void VegaXmlPlotter::shareData(){
+	sharedData.insert( configData.begin(), configData.end() );
+} // shareData
+
+set<string> VegaXmlPlotter::visibleData(){
+	set<string> names = sharedData;
+	names.insert( configData.begin(), configData.end() );
+	return names;
+} // visibleData
+
+string VegaXmlPlotter::defaultData(){
+	// the first file declared by this config, a batch keeps the files of earlier configs open
+	set<string> names = visibleData();
+	for ( string name : names )
+		if ( dataUrls.count( name ) > 0 )
+			return name;
+	for ( string name : names )
+		if ( mergedUrls.count( name ) > 0 )
+			return name;
+	return "";
+} // defaultData
+
+string VegaXmlPlotter::defaultChain(){
+	// only when this config declares exactly one chain, skims included
+	string chain = "";
+	for ( string name : visibleData() ){
+		if ( dataChains.count( name ) == 0 && plannedSkims.count( name ) == 0 ) continue;
+		if ( "" != chain ) return "";
+		chain = name;
+	}
+	return chain;
+} // defaultChain
+
 
 TObject* VegaXmlPlotter::findObject( string _path ){
 	DSCOPE();
@@ -316,13 +839,34 @@ TObject* VegaXmlPlotter::findObject( string _path ){
 		name = nameOnly( name );
 	}
 
-	//INFO( classname(), "Looking for [" << name << "] in " << data << "=(" << dataFiles[data] <<")" );
+	if ( mergedUrls.count( data ) > 0 )
+		return mergedHistogram( data, name );
+
 	// first check for a normal histogram from a root file
-	if ( dataFiles.count( data ) > 0 && dataFiles[ data ] ){
+	TFile * f = dataFile( data );
+	if ( nullptr != f ){
 		LOG_F( INFO, "Lokking in %s", data.c_str() );
-		if ( nullptr == dataFiles[ data ]->Get( name.c_str() ) ) return nullptr;
-		TObject * obj = (TH1*)dataFiles[ data ]->Get( name.c_str() );
-		return obj;
+		TObject * obj = f->Get( name.c_str() );
+		if ( nullptr == obj ) return nullptr;
+		// histograms belong to the file, detach them so they survive the file being closed
+		if ( nullptr != dynamic_cast<TH1*>( obj ) ){
+			((TH1*)obj)->SetDirectory( nullptr );
+			return obj;
+		}
+		// trees cannot leave their file, keep it open
+		if ( obj->InheritsFrom( "TTree" ) ){
+			dataPool.pin( dataUrls[ data ] );
+			return obj;
+		}
+		// anything else (graphs, functions, ...) is copied out of the file
+		TObject * copy = nullptr;
+		{
+			TDirectory::TContext ctx( nullptr );
+			copy = obj->Clone();
+		}
+		if ( nullptr == f->GetList()->FindObject( obj ) )
+			delete obj;
+		return copy;
 	}
 
 	// finally look for histos we made and named in the ttree drawing
@@ -359,18 +903,38 @@ TH1 *VegaXmlPlotter::findHistogram( string _data, string _name, string _path, in
 		return globalHistos[ name ];
 	}
 
-	DLOG( "data=%s, name=%s, dataFiles.size()=%lu", data.c_str(), name.c_str(), dataFiles.size() );
-	if ( "" == data && dataFiles.size() >= 1 ){
-		data = dataFiles.begin()->first;
+	DLOG( "data=%s, name=%s, dataUrls.size()=%lu", data.c_str(), name.c_str(), dataUrls.size() );
+	if ( "" == data ){
+		data = defaultData();
 		DLOG( "data was not set -> setting to %s", data.c_str()  );
 	}
 
-	//INFO( classname(), "Looking for [" << name << "] in " << data << "=(" << dataFiles[data] <<")" );
+	// the sum over all files of a merged <Data urls="..."/>
+	if ( mergedUrls.count( data ) > 0 ){
+		TH1 * h = mergedHistogram( data, name );
+		if ( nullptr != h && false == config.getBool( _path + ":setdir", true ) )
+			h->SetDirectory( 0 );
+		return h;
+	}
+
 	// first check for a normal histogram from a root file
-	if ( dataFiles.count( data ) > 0 && dataFiles[ data ] ){
+	// histograms read ahead by a Loop in the background
+	if ( dataUrls.count( data ) > 0 ){
+		TH1 * h = prefetcher.take( dataUrls[ data ], name );
+		if ( nullptr != h ){
+			LOG_F( INFO, "Found histogram [%s] in prefetch", name.c_str() );
+			h->SetName( (string("hist_") + h->GetName() ).c_str() );
+			if ( config.getBool( _path + ":setdir", true ) )
+				h->SetDirectory( gDirectory );
+			return h;
+		}
+	}
+
+	TFile * f = dataFile( data );
+	if ( nullptr != f ){
 
 
-		TH1 * h = (TH1*)dataFiles[ data ]->Get( name.c_str() );
+		TH1 * h = (TH1*)f->Get( name.c_str() );
 		if ( nullptr != h ){
 			h = (TH1*)h->Clone( (string("hist_") + h->GetName() ).c_str() );
 			if ( config.getBool( _path + ":setdir", true ) ){} 
@@ -418,9 +982,9 @@ TH1* VegaXmlPlotter::makeHistoFromDataTree( string _path, int iHist ){
 		hName = nameOnly( hName );
 	}
 
-	if ( "" == data && dataChains.size() == 1 ){
-		data = dataChains.begin()->first;
-	} else if ( "" == data ){
+	if ( "" == data )
+		data = defaultChain();
+	if ( "" == data ){
 		LOG_F( ERROR, "Must specify the data source" );
 		return nullptr;
 	}
@@ -460,6 +1024,19 @@ TH1* VegaXmlPlotter::makeHistoFromDataTree( string _path, int iHist ){
 		}
 	}
 	
+	// equal-population bins found in the same pass that fills the histogram
+	string autoBins = config.getXString( _path + ":bins_x" );
+	if ( 0 == autoBins.find( "auto:quantile" ) ){
+		int nq = 100;
+		string prefix = "auto:quantile:";
+		if ( autoBins.size() > prefix.size() )
+			nq = std::max( 1, atoi( autoBins.substr( prefix.size() ).c_str() ) );
+		TH1 * h = makeQuantileBinnedHisto( _path, data, hName, title, nq );
+		if ( nullptr != h )
+			globalHistos[ hName ] = h;
+		return h;
+	}
+
 	// if bins are given lets assume we need to make the histo first
 	if ( config.exists( _path + ":bins_x" ) ){
 		HistoBins bx( config, config.getXString( _path + ":bins_x" ) );
@@ -477,13 +1054,44 @@ TH1* VegaXmlPlotter::makeHistoFromDataTree( string _path, int iHist ){
 		LOG_S(INFO) << "TTree->Draw( " << quote(drawCmd) << ", " << quote(selectCmd) << ", " << quote(drawOpt) << " );";
 	}
 
-	chain->Draw( drawCmd.c_str(), selectCmd.c_str(), drawOpt.c_str(), N );
+	// only iterate the entries that survive the selection, the cut is still applied
+	// so that weights in the select expression are respected
+	TEntryList * elist = nullptr;
+	if ( config.getBool( _path + ":entrylist", true ) )
+		elist = selectionEntryList( data, selectCmd, N );
+	// in preview the selection list is already restricted to the sample
+	if ( nullptr == elist )
+		elist = sampleEntryList( data );
+	if ( nullptr != elist )
+		chain->SetEntryList( elist );
+
+	// segments after the first would overflow a range picked from the first one
+	bool progress = config.exists( _path + ":progress" );
+	if ( progress && false == config.exists( _path + ":bins_x" ) ){
+		LOG_F( WARNING, "progress on %s needs bins_x, drawing it in one pass", hName.c_str() );
+		progress = false;
+	}
+	if ( progress )
+		progressiveDraw( _path, chain, config.getXString( _path + ":draw" ), hName, selectCmd, drawOpt, N, elist );
+	else
+		chain->Draw( drawCmd.c_str(), selectCmd.c_str(), drawOpt.c_str(), N );
+
+	if ( nullptr != elist )
+		chain->SetEntryList( nullptr );
 	TH1 *h = (TH1*)gPad->GetPrimitive( hName.c_str() );
 
+	// scale a sampled draw back up so that normalizations match the full chain
+	double scale = previewScale( data, N );
+	if ( nullptr != h && scale != 1.0 ){
+		h->Scale( scale );
+		LOG_F( INFO, "Preview: scaled %s by %f", hName.c_str(), scale );
+	}
+
 	if ( config.exists( _path +":after_draw" ) ){
-		string cmd = ".x " + config[_path+":after_ draw"] + "( " + h->GetName() + " )";
+		string cmd = ".x " + config[_path+":after_draw"] + "( " + h->GetName() + " )";
 		LOG_F( INFO, "Executing: %s", cmd.c_str()  );
 		// gROOT->ProcessLine( cmd.c_str() );
+		interpreter();
 		gROOT->LoadMacro( config[_path+":after_draw"].c_str() );
 		gROOT->ProcessLine( "after_draw()" );
 	}	
@@ -493,6 +1101,523 @@ TH1* VegaXmlPlotter::makeHistoFromDataTree( string _path, int iHist ){
 	return h;
 } // makeHistoFromDataTree
 
+TH1* VegaXmlPlotter::makeDensityFromDataTree( string _path ){
+	DSCOPE();
+
+	string data = config.getXString( _path + ":data" );
+	string hName = nameOnly( config.getXString( _path + ":name" ) );
+	if ( "" == data )
+		data = defaultChain();
+	TChain * chain = dataChains.count( data ) > 0 ? dataChains[ data ] : nullptr;
+	if ( nullptr == chain ){
+		LOG_F( ERROR, "Density needs a chain, data=%s", quote(data).c_str() );
+		return nullptr;
+	}
+
+	// "y:x" with the same order as TTree::Draw, "::" is part of an expression
+	string draw = config.getXString( _path + ":draw" );
+	size_t split = string::npos;
+	for ( size_t i = 0; i < draw.size(); i++ ){
+		if ( ':' != draw[i] ) continue;
+		if ( i + 1 < draw.size() && ':' == draw[i+1] ){ i++; continue; }
+		split = i;
+		break;
+	}
+	if ( string::npos == split ){
+		LOG_F( ERROR, "Density needs draw=\"y:x\", got %s", quote(draw).c_str() );
+		return nullptr;
+	}
+	string yExpr = draw.substr( 0, split );
+	string xExpr = draw.substr( split + 1 );
+
+	string agg = config.getXString( _path + ":agg", "count" );
+	string value = config.getXString( _path + ":value" );
+	if ( "count" != agg && "" == value ){
+		LOG_F( ERROR, "agg=%s needs a value expression", agg.c_str() );
+		return nullptr;
+	}
+	vector<string> exprs = { xExpr, yExpr };
+	if ( "count" != agg ) exprs.push_back( value );
+
+	// one bin per pixel of the current frame unless given
+	int w = 800, h = 600;
+	Downsample::framePixels( gPad, w, h );
+	w = config.getInt( _path + ":width", w );
+	h = config.getInt( _path + ":height", h );
+
+	Long64_t N = config.get<Long64_t>( _path + ":N", std::numeric_limits<Long64_t>::max() );
+	int nThreads = std::max( 1, config.getInt( _path + ":threads", config.getInt( "threads", 1 ) ) );
+	string select = config.getXString( _path + ":select" );
+	// the same entries as a plain Draw: selection list, else the preview sample
+	TEntryList * elist = nullptr;
+	if ( config.getBool( _path + ":entrylist", true ) )
+		elist = selectionEntryList( data, select, N );
+	if ( nullptr == elist )
+		elist = sampleEntryList( data );
+	TreeFormulaLoop tfl( chain, exprs, select, elist );
+
+	vector<double> xr = config.getDoubleVector( _path + ":xrange" );
+	vector<double> yr = config.getDoubleVector( _path + ":yrange" );
+	if ( xr.size() < 2 || yr.size() < 2 ){
+		LOG_F( WARNING, "No xrange/yrange for density %s, finding the range costs an extra pass", hName.c_str() );
+		vector<double> lo( 2 * nThreads, std::numeric_limits<double>::max() );
+		vector<double> hi( 2 * nThreads, std::numeric_limits<double>::lowest() );
+		tfl.run( [&]( int t, const vector<double> &v, double ){
+			for ( int k = 0; k < 2; k++ ){
+				lo[ 2*t + k ] = std::min( lo[ 2*t + k ], v[k] );
+				hi[ 2*t + k ] = std::max( hi[ 2*t + k ], v[k] );
+			}
+		}, nThreads, N );
+		for ( int t = 1; t < nThreads; t++ ){
+			for ( int k = 0; k < 2; k++ ){
+				lo[k] = std::min( lo[k], lo[ 2*t + k ] );
+				hi[k] = std::max( hi[k], hi[ 2*t + k ] );
+			}
+		}
+		if ( lo[0] > hi[0] ){
+			LOG_F( WARNING, "No entries selected for density %s", hName.c_str() );
+			lo[0] = lo[1] = 0; hi[0] = hi[1] = 1;
+		}
+		// include the maximum in the last bin
+		if ( xr.size() < 2 ) xr = { lo[0], hi[0] + ( hi[0] - lo[0] ) * 1e-6 };
+		if ( yr.size() < 2 ) yr = { lo[1], hi[1] + ( hi[1] - lo[1] ) * 1e-6 };
+	}
+
+	// every worker fills its own sum (and count for the mean)
+	TDirectory::TContext ctx( nullptr );
+	vector<TH2D*> sums, counts;
+	for ( int t = 0; t < nThreads; t++ ){
+		sums.push_back( new TH2D( TString::Format( "%s_sum%d", hName.c_str(), t ), "", w, xr[0], xr[1], h, yr[0], yr[1] ) );
+		counts.push_back( "mean" == agg ? new TH2D( TString::Format( "%s_n%d", hName.c_str(), t ), "", w, xr[0], xr[1], h, yr[0], yr[1] ) : nullptr );
+	}
+
+	bool isCount = ( "count" == agg );
+	Long64_t nVisited = tfl.run( [&]( int t, const vector<double> &v, double weight ){
+		if ( isCount ){
+			sums[t]->Fill( v[0], v[1], weight );
+		} else {
+			sums[t]->Fill( v[0], v[1], v[2] * weight );
+			if ( counts[t] ) counts[t]->Fill( v[0], v[1], weight );
+		}
+	}, nThreads, N );
+
+	for ( size_t t = 1; t < sums.size(); t++ ){
+		sums[0]->Add( sums[t] );
+		delete sums[t];
+		if ( counts[t] ){
+			counts[0]->Add( counts[t] );
+			delete counts[t];
+		}
+	}
+	TH2D * hd = sums[0];
+	if ( counts[0] ){
+		hd->Divide( counts[0] );
+		delete counts[0];
+	} else {
+		// counts and sums of a preview are scaled up, means are not
+		double scale = previewScale( data, N );
+		if ( scale != 1.0 )
+			hd->Scale( scale );
+	}
+
+	hd->SetName( hName.c_str() );
+	string title = config.getXString( _path + ":title", ";" + xExpr + ";" + yExpr + ";" + ( "count" == agg ? string("entries") : agg + "(" + value + ")" ) );
+	hd->SetTitle( title.c_str() );
+	hd->SetStats( false );
+	hd->SetOption( "colz" );
+	hd->SetEntries( nVisited );
+	LOG_F( INFO, "Density %s: %dx%d pixels, %s over %lld entries (%d threads)", hName.c_str(), w, h, agg.c_str(), nVisited, nThreads );
+	return hd;
+} // makeDensityFromDataTree
+
+TH1* VegaXmlPlotter::makeQuantileBinnedHisto( string _path, string _data, string _name, string _title, int _nBins ){
+	DSCOPE();
+	string draw = config.getXString( _path + ":draw" );
+	if ( draw.find( ':' ) != string::npos && draw.find( "::" ) == string::npos ){
+		LOG_F( ERROR, "auto:quantile binning is only supported for 1D draws, got %s", quote(draw).c_str() );
+		return nullptr;
+	}
+
+	TChain * chain = dataChains[ _data ];
+	Long64_t N = config.get<Long64_t>( _path + ":N", std::numeric_limits<Long64_t>::max() );
+	int nThreads = std::max( 1, config.getInt( _path + ":threads", config.getInt( "threads", 1 ) ) );
+	string select = config.getXString( _path + ":select" );
+
+	// the same entries as a plain Draw: selection list, else the preview sample
+	TEntryList * elist = nullptr;
+	if ( config.getBool( _path + ":entrylist", true ) )
+		elist = selectionEntryList( _data, select, N );
+	if ( nullptr == elist )
+		elist = sampleEntryList( _data );
+	TreeFormulaLoop tfl( chain, { draw }, select, elist );
+
+	TDirectory::TContext ctx( nullptr );
+	// one pass fills the weighted sketch for the edges and a fine staging
+	// histogram whose range extends with the data, it is rebinned onto the edges
+	bool exact = config.getBool( _path + ":exact", false );
+	int nStaging = std::max( _nBins, config.getInt( _path + ":staging", 100000 ) );
+	vector<QuantileSketch> sketches( nThreads, QuantileSketch( config.getInt( _path + ":k", 200 ) ) );
+	vector<TH1D*> staging;
+	for ( int t = 0; t < nThreads && false == exact; t++ ){
+		// no range, the first buffered entries pick it and later ones extend it
+		TH1D * s = new TH1D( TString::Format( "%s_staging%d", _name.c_str(), t ), "", nStaging, 0, 0 );
+		s->SetCanExtend( TH1::kAllAxes );
+		s->Sumw2();
+		staging.push_back( s );
+	}
+	Long64_t nVisited = tfl.run( [&]( int t, const vector<double> &v, double w ){
+		sketches[t].add( v[0], w );
+		if ( false == exact )
+			staging[t]->Fill( v[0], w );
+	}, nThreads, N );
+	for ( int t = 1; t < nThreads; t++ )
+		sketches[0].merge( sketches[t] );
+
+	vector<double> edges = sketches[0].equalPopulationEdges( _nBins );
+	if ( edges.size() < 2 ){
+		LOG_F( WARNING, "Not enough entries for quantile bins in %s", _name.c_str() );
+		double lo = sketches[0].count() > 0 ? sketches[0].minimum() : 0;
+		edges = { lo, lo + 1 };
+	}
+
+	TH1D * h = nullptr;
+	if ( false == exact ){
+		TList others;
+		for ( int t = 0; t < nThreads; t++ ){
+			staging[t]->BufferEmpty();
+			if ( t > 0 ) others.Add( staging[t] );
+		}
+		if ( others.GetSize() > 0 )
+			staging[0]->Merge( &others );
+		others.Clear();
+		for ( int t = 1; t < nThreads; t++ )
+			delete staging[t];
+		TH1D * fine = staging[0];
+		TAxis * ax = fine->GetXaxis();
+
+		// edges are moved to the nearest staging bin edge, then every staging bin lies in one final bin
+		bool filled = ax->GetXmax() > ax->GetXmin();
+		vector<double> snapped = { filled ? ax->GetXmin() : edges.front() };
+		for ( size_t i = 1; filled && i + 1 < edges.size(); i++ ){
+			int b = ax->FindFixBin( edges[i] );
+			if ( b < 1 || b > ax->GetNbins() ) continue;
+			double e = edges[i] - ax->GetBinLowEdge( b ) < ax->GetBinWidth( b ) / 2 ? ax->GetBinLowEdge( b ) : ax->GetBinUpEdge( b );
+			if ( e > snapped.back() && e < ax->GetXmax() )
+				snapped.push_back( e );
+		}
+		snapped.push_back( filled ? ax->GetXmax() : edges.back() );
+
+		h = new TH1D( _name.c_str(), _title.c_str(), snapped.size() - 1, snapped.data() );
+		h->Sumw2();
+		for ( int i = 0; filled && i <= fine->GetNbinsX() + 1; i++ ){
+			int b = 0 == i ? 0 : ( i > fine->GetNbinsX() ? h->GetNbinsX() + 1 : h->FindFixBin( fine->GetBinCenter( i ) ) );
+			h->SetBinContent( b, h->GetBinContent( b ) + fine->GetBinContent( i ) );
+			h->SetBinError( b, std::sqrt( std::pow( h->GetBinError( b ), 2 ) + std::pow( fine->GetBinError( i ), 2 ) ) );
+		}
+		h->SetEntries( fine->GetEntries() );
+		delete fine;
+	} else {
+		// exact="true": a second pass fills the edges of the sketch straight from the tree
+		// make sure the maximum lands inside the last bin
+		edges.back() += std::max( 1e-9, ( edges.back() - edges.front() ) * 1e-9 );
+		vector<TH1D*> partials;
+		for ( int t = 0; t < nThreads; t++ ){
+			TH1D * p = new TH1D( TString::Format( "%s_part%d", _name.c_str(), t ), _title.c_str(), edges.size() - 1, edges.data() );
+			p->Sumw2();
+			partials.push_back( p );
+		}
+		nVisited = tfl.run( [&]( int t, const vector<double> &v, double w ){
+			partials[t]->Fill( v[0], w );
+		}, nThreads, N );
+		for ( int t = 1; t < nThreads; t++ ){
+			partials[0]->Add( partials[t] );
+			delete partials[t];
+		}
+		h = partials[0];
+		h->SetName( _name.c_str() );
+	}
+
+	// scale a sampled draw back up so that normalizations match the full chain
+	double scale = previewScale( _data, N );
+	if ( scale != 1.0 )
+		h->Scale( scale );
+
+	LOG_F( INFO, "Made %s with %d quantile bins from %lld entries in %s", _name.c_str(), h->GetNbinsX(), nVisited, exact ? "two passes" : "one pass" );
+	return h;
+} // makeQuantileBinnedHisto
+
+TEntryList* VegaXmlPlotter::selectionEntryList( string _data, string _select, long _N ){
+	DSCOPE();
+	TChain * chain = dataChains[ _data ];
+	if ( nullptr == chain || "" == _select )
+		return nullptr;
+
+	string mode = chainSelectCache.count( _data ) > 0 ? chainSelectCache[ _data ] : "true";
+	if ( "false" == mode || "0" == mode )
+		return nullptr;
+
+	// lists built from other files (added, replaced or rewritten) are not reused
+	string signature = chainSignature( _data );
+
+	// a preview keeps its own lists, built on top of the sample
+	TEntryList * sample = sampleEntryList( _data );
+	string key = SelectionCache::key( _data, _select, _N, signature );
+	if ( nullptr != sample )
+		key += "|sample=" + dts( sampleFraction( _data ) );
+	if ( selectionCache.count( key ) > 0 && selectionCache[ key ] ){
+		LOG_F( INFO, "Using cached entry list for [%s] (%lld entries)", _select.c_str(), selectionCache[ key ]->GetN() );
+		return selectionCache[ key ];
+	}
+
+	string elName = SelectionCache::name( key );
+	string url = chainSelectCacheUrl.count( _data ) > 0 ? chainSelectCacheUrl[ _data ] : "";
+	// keep the current directory (output TFile) untouched
+	TDirectory::TContext ctx( gROOT );
+
+	TEntryList * elist = nullptr;
+	if ( "" != url && false == gSystem->AccessPathName( url.c_str() ) ){
+		TFile fcache( url.c_str() );
+		TEntryList * el = dynamic_cast<TEntryList*>( fcache.Get( elName.c_str() ) );
+		if ( SelectionCache::matches( el, _select, signature ) ){
+			elist = (TEntryList*)el->Clone( elName.c_str() );
+			elist->SetDirectory( nullptr );
+			LOG_F( INFO, "Loaded entry list for [%s] from %s", _select.c_str(), url.c_str() );
+		}
+		fcache.Close();
+	}
+
+	// building a list costs a pass of its own, a one-off cut is only drawn
+	if ( nullptr == elist && "disk" != mode && selectionSeen.insert( key ).second ){
+		LOG_F( INFO, "First use of [%s] on %s, not building an entry list yet", _select.c_str(), _data.c_str() );
+		return nullptr;
+	}
+
+	if ( nullptr == elist ){
+		LOG_S(INFO) << "Building entry list for " << quote(_select) << " on " << quote(_data);
+		chain->SetEntryList( sample );
+		chain->Draw( (">>" + elName).c_str(), _select.c_str(), "entrylist", _N );
+		chain->SetEntryList( nullptr );
+		elist = dynamic_cast<TEntryList*>( gROOT->Get( elName.c_str() ) );
+		if ( nullptr == elist ){
+			LOG_F( WARNING, "Could not build entry list for [%s]", _select.c_str() );
+			return nullptr;
+		}
+		elist->SetDirectory( nullptr );
+		elist->SetTitle( SelectionCache::title( _select, signature ).c_str() );
+
+		if ( "" != url ){
+			TFile fcache( url.c_str(), "UPDATE" );
+			if ( fcache.IsOpen() ){
+				elist->Write( elName.c_str(), TObject::kOverwrite );
+				LOG_F( INFO, "Saved entry list for [%s] to %s", _select.c_str(), url.c_str() );
+			}
+			fcache.Close();
+		}
+	}
+
+	LOG_F( INFO, "Selection [%s] keeps %lld entries", _select.c_str(), elist->GetN() );
+	selectionCache[ key ] = elist;
+	return elist;
+} // selectionEntryList
+
+void VegaXmlPlotter::progressiveDraw( string _path, TChain * _chain, string _draw, string _hName, string _select, string _opt, Long64_t _N, TEntryList * _elist ){
+	DSCOPE();
+	// with an entry list the first/n entries of Draw count entries of the list
+	Long64_t total = nullptr != _elist ? _elist->GetN() : _chain->GetEntries();
+	total = std::min( total, _N );
+	if ( total <= 0 ) return;
+
+	// segment boundaries: every snapshot fraction and every log step
+	vector<double> snapshots = config.getDoubleVector( _path + ":progress" );
+	double step = config.getDouble( _path + ":progress_step", 0.1 );
+	set<double> marks( snapshots.begin(), snapshots.end() );
+	for ( double f = step; step > 0 && f < 1.0; f += step )
+		marks.insert( f );
+	marks.insert( 1.0 );
+
+	string snapshotUrl = config.getXString( _path + ":snapshot", "" );
+	auto t0 = std::chrono::steady_clock::now();
+	Long64_t bytes0 = TFile::GetFileBytesRead();
+	Long64_t done = 0;
+	for ( double f : marks ){
+		if ( f <= 0 || f > 1.0 ) continue;
+		Long64_t end = std::min( total, (Long64_t)std::llround( f * total ) );
+		if ( end <= done ) continue;
+
+		// the histogram is booked with bins_x, every segment adds to it
+		_chain->Draw( ( _draw + " >>+ " + _hName ).c_str(), _select.c_str(), _opt.c_str(), end - done, done );
+		done = end;
+
+		double secs = std::chrono::duration<double>( std::chrono::steady_clock::now() - t0 ).count();
+		double mb = ( TFile::GetFileBytesRead() - bytes0 ) / ( 1024.0 * 1024.0 );
+		double rate = secs > 0 ? done / secs : 0;
+		double eta = rate > 0 ? ( total - done ) / rate : 0;
+		LOG_F( INFO, "Draw %s: %5.1f%% (%lld/%lld entries) %.3g entries/s %.1f MB/s ETA %02d:%02d:%02d",
+			_hName.c_str(), 100.0 * done / total, done, total, rate, secs > 0 ? mb / secs : 0.0,
+			(int)eta / 3600, ( (int)eta / 60 ) % 60, (int)eta % 60 );
+
+		// export what has been accumulated so far, {progress} is the percentage done
+		if ( "" != snapshotUrl && done < total && std::find( snapshots.begin(), snapshots.end(), f ) != snapshots.end() ){
+			pushFrame();
+			setVar( "progress", ts( (int)std::llround( 100 * f ) ) );
+			string url = config.getXString( _path + ":snapshot" );
+			popFrame();
+			snapshot( _path, _hName, url );
+			LOG_F( INFO, "Snapshot at %s of %s -> %s", ( dts( 100 * f ) + "%" ).c_str(), _hName.c_str(), url.c_str() );
+		}
+	}
+} // progressiveDraw
+
+void VegaXmlPlotter::snapshot( string _path, string _hName, string _url ){
+	DSCOPE();
+	TH1 * h = dynamic_cast<TH1*>( gDirectory->Get( _hName.c_str() ) );
+	if ( nullptr == h ){
+		LOG_F( WARNING, "No %s to snapshot yet", _hName.c_str() );
+		return;
+	}
+
+	// a copy styled like the Plot draws it, on a canvas of its own so the pad
+	// of the draw (empty with goff) and the histogram itself are left alone
+	TVirtualPad * current = gPad;
+	int width = nullptr != current ? current->GetWw() : 800;
+	int height = nullptr != current ? current->GetWh() : 600;
+	TDirectory::TContext ctx( nullptr );
+	TCanvas * c = new TCanvas( "progress_snapshot", "", width, height );
+	TH1 * copy = (TH1*)h->Clone( ( _hName + "_snapshot" ).c_str() );
+	copy->SetDirectory( nullptr );
+
+	RooPlotLib rpl;
+	string styleRef = config.getXString( _path + ":style" );
+	if ( config.exists( styleRef ) )
+		rpl.style( copy ).set( config, styleRef );
+	rpl.style( copy ).set( config, _path ).set( config, _path + ".style" ).draw();
+	c->Print( _url.c_str() );
+
+	delete c;
+	delete copy;
+	if ( nullptr != current )
+		current->cd();
+} // snapshot
+
+double VegaXmlPlotter::sampleFraction( string _data ){
+	double f = chainSample.count( _data ) > 0 ? chainSample[ _data ] : config.getDouble( "preview", 0 );
+	if ( f <= 0 || f >= 1 ) return 0;
+	return f;
+} // sampleFraction
+
+TEntryList* VegaXmlPlotter::sampleEntryList( string _data ){
+	DSCOPE();
+	double f = sampleFraction( _data );
+	TChain * chain = dataChains.count( _data ) > 0 ? dataChains[ _data ] : nullptr;
+	if ( f <= 0 || nullptr == chain || nullptr == chain->GetListOfFiles() )
+		return nullptr;
+
+	string key = _data + "|" + dts( f );
+	if ( sampleCache.count( key ) > 0 ){
+		// cached by an earlier config of a batch, the scale is per config
+		TEntryList * cached = sampleCache[ key ];
+		if ( nullptr != cached && cached->GetN() > 0 )
+			sampleScale[ key ] = (double)chain->GetEntries() / cached->GetN();
+		return cached;
+	}
+
+	Long64_t stride = std::max( (Long64_t)1, (Long64_t)std::llround( 1.0 / f ) );
+	string treeName = chain->GetName();
+	bool clusters = chainManifests.count( _data ) > 0;
+
+	TDirectory::TContext ctx( gROOT );
+	TEntryList * elist = new TEntryList( TString::Format( "sample_%zx", std::hash<string>()( key ) ), "preview sample" );
+	elist->SetDirectory( nullptr );
+
+	// without a manifest the per-file entry counts have to be known
+	if ( false == clusters )
+		chain->GetEntries();
+
+	Long64_t total = 0, kept = 0, nCluster = 0;
+	TIter next( chain->GetListOfFiles() );
+	TChainElement * el = nullptr;
+	while ( (el = (TChainElement*)next()) ){
+		string fname = el->GetTitle();
+		elist->SetTree( treeName.c_str(), fname.c_str() );
+		if ( clusters && chainManifests[ _data ].has( fname ) ){
+			// every stride-th cluster across the chain, whole baskets are skipped
+			ChainManifest::Entry &e = chainManifests[ _data ][ fname ];
+			for ( size_t j = 0; j < e.clusters.size(); j++, nCluster++ ){
+				if ( nCluster % stride != 0 ) continue;
+				Long64_t end = j + 1 < e.clusters.size() ? e.clusters[ j + 1 ] : e.entries;
+				for ( Long64_t i = e.clusters[ j ]; i < end; i++ )
+					elist->Enter( i );
+				kept += end - e.clusters[ j ];
+			}
+			total += e.entries;
+		} else {
+			// every stride-th entry, continuing the stride across file boundaries
+			Long64_t n = el->GetEntries();
+			for ( Long64_t i = ( stride - total % stride ) % stride; i < n; i += stride ){
+				elist->Enter( i );
+				kept++;
+			}
+			total += n;
+		}
+	}
+
+	if ( kept <= 0 ){
+		LOG_F( WARNING, "Preview sample of %s is empty, using all entries", _data.c_str() );
+		delete elist;
+		sampleCache[ key ] = nullptr;
+		return nullptr;
+	}
+
+	sampleScale[ key ] = (double)total / kept;
+	sampleCache[ key ] = elist;
+	LOG_F( INFO, "Preview of %s: %lld of %lld entries (%s sampling, f=%f)", _data.c_str(), kept, total, clusters ? "cluster" : "strided", f );
+	return elist;
+} // sampleEntryList
+
+double VegaXmlPlotter::previewScale( string _data, Long64_t _N ){
+	// the entries a full draw would process over the sample entries processed,
+	// both limited by N, 1 when this config did not draw from a sample
+	string key = _data + "|" + dts( sampleFraction( _data ) );
+	if ( sampleFraction( _data ) <= 0 || sampleScale.count( key ) == 0 || sampleCache.count( key ) == 0 )
+		return 1.0;
+	TEntryList * sample = sampleCache.find( key )->second;
+	TChain * chain = dataChains.count( _data ) > 0 ? dataChains.find( _data )->second : nullptr;
+	if ( nullptr == sample || nullptr == chain || sample->GetN() <= 0 )
+		return 1.0;
+	Long64_t total = std::min( chain->GetEntries(), _N );
+	Long64_t kept = std::min( sample->GetN(), _N );
+	return (double)total / kept;
+} // previewScale
+
+string VegaXmlPlotter::chainSignature( string _data ){
+	DSCOPE();
+	// name, size, modification time and entries of every file, stat'ed once per chain
+	if ( chainSignatures.count( _data ) == 0 && dataChains.count( _data ) > 0 )
+		chainSignatures[ _data ] = SelectionCache::signature( dataChains[ _data ], chainManifests.count( _data ) > 0 );
+	return chainSignatures.count( _data ) > 0 ? chainSignatures[ _data ] : "";
+} // chainSignature
+
+int VegaXmlPlotter::compressionSettings( string _spec, int _default ){
+	// "algorithm:level", e.g. "lz4:4", "zstd:5", "zlib:1", "lzma:9"
+	if ( "" == _spec ) return _default;
+	std::transform( _spec.begin(), _spec.end(), _spec.begin(), ::tolower );
+
+	string alg = _spec;
+	int level = 4;
+	if ( _spec.find( ":" ) != string::npos ){
+		alg = _spec.substr( 0, _spec.find( ":" ) );
+		level = atoi( _spec.substr( _spec.find( ":" ) + 1 ).c_str() );
+	}
+
+	if ( "none" == alg || "0" == alg ) return 0;
+	if ( "zlib" == alg ) return ROOT::CompressionSettings( ROOT::kZLIB, level );
+	if ( "lzma" == alg ) return ROOT::CompressionSettings( ROOT::kLZMA, level );
+	if ( "lz4"  == alg ) return ROOT::CompressionSettings( ROOT::kLZ4,  level );
+	if ( "zstd" == alg ) return ROOT::CompressionSettings( ROOT::kZSTD, level );
+
+	LOG_F( WARNING, "Unknown compression %s, using default", _spec.c_str() );
+	return _default;
+} // compressionSettings
 
 map<string, TObject*> VegaXmlPlotter::dirMap( TDirectory *dir, string prefix, bool dive ) {
 	DSCOPE();
@@ -519,10 +1644,38 @@ map<string, TObject*> VegaXmlPlotter::dirMap( TDirectory *dir, string prefix, bo
 	return mp;
 }
 
+map<string, string> VegaXmlPlotter::keyMap( TDirectory *dir, string prefix, bool dive ) {
+	DSCOPE();
+
+	map<string, string> mp;
+	if ( nullptr == dir ) return mp;
+
+	TList* list = dir->GetListOfKeys() ;
+	if ( !list ) return mp;
+
+	TIter next(list) ;
+	TKey* key ;
+	while ( (key = (TKey*)next()) ) {
+		string name = prefix + key->GetName();
+		string cls = key->GetClassName();
+		// keep the highest cycle only
+		if ( mp.count( name ) > 0 ) continue;
+		mp[ name ] = cls;
+		if ( dive && "TDirectoryFile" == cls ){
+			auto m = keyMap( dir->GetDirectory( key->GetName() ), name + "/" );
+			mp.insert( m.begin(), m.end() );
+		}
+	}
+	return mp;
+}
+
 bool VegaXmlPlotter::typeMatch( TObject *obj, string type ){
 	if ( nullptr == obj ) return false;
+	return typeMatch( string( obj->ClassName() ), type );
+}
+
+bool VegaXmlPlotter::typeMatch( string objType, string type ){
 	if ( "" == type ) return true;
-	string objType = obj->ClassName();
 	if ( objType.substr( 0, type.length() ) == type ) return true;
 	return false;
 }
@@ -559,16 +1712,26 @@ vector<string> VegaXmlPlotter::glob( string query ){
 			}
 		}
 
-		// now try data files:
-		for ( auto df : dataFiles ){
-			auto objs = dirMap( df.second);
-			for ( auto kv : objs ){
-				DLOG( "[%s]=%s, typeMatch=%s", kv.first.c_str(), kv.second->ClassName(), bts( typeMatch( kv.second, type ) ).c_str() );
+		// now try data files, only the keys are needed to match
+		for ( auto df : dataUrls ){
+			auto keys = keyMap( dataFile( df.first ) );
+			for ( auto kv : keys ){
+				DLOG( "[%s]=%s, typeMatch=%s", kv.first.c_str(), kv.second.c_str(), bts( typeMatch( kv.second, type ) ).c_str() );
 				if ( kv.first.substr( 0, pos ) == qc && typeMatch( kv.second, type ) ){
 					names.push_back( df.first + "/" + kv.first );
 				}
 			}
-		} // loop dataFiles
+		} // loop dataUrls
+
+		// merged sources list the keys of their first file
+		for ( auto ms : mergedUrls ){
+			if ( ms.second.size() == 0 ) continue;
+			auto keys = keyMap( dataPool.get( ms.second[0] ) );
+			for ( auto kv : keys ){
+				if ( kv.first.substr( 0, pos ) == qc && typeMatch( kv.second, type ) )
+					names.push_back( ms.first + "/" + kv.first );
+			}
+		}
 		
 
 
@@ -580,6 +1743,26 @@ vector<string> VegaXmlPlotter::glob( string query ){
 	return names;
 }
 
+void VegaXmlPlotter::interpreter(){
+	if ( true == initializedGROOT ) return;
+	initializedGROOT = true;
+	// TCling itself exists from startup, the first ProcessLine pays for parsing this preamble
+	NodeProfiler::Span span( profiler, "Interpreter", "", "" );
+	auto start = std::chrono::steady_clock::now();
+	// objects used by Assign and Format to pass results back
+	gROOT->ProcessLine( "#include \"sstream\" " );
+	gROOT->ProcessLine( "std::stringstream sstr;" );
+	gROOT->ProcessLine( "TNamed * tn = 0;" );
+	gROOT->ProcessLine( "TH1 * h = 0;" );
+	LOG_F( INFO, "Interpreter ready in %0.1f ms", std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+} // interpreter
+
+void VegaXmlPlotter::graphics(){
+	if ( true == initializedGraphics ) return;
+	initializedGraphics = true;
+	setDefaultPalette();
+} // graphics
+
 void VegaXmlPlotter::setDefaultPalette(){
 	const Int_t NRGBs = 5;
 	const Int_t NCont = 255;
@@ -0,0 +1,24 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+// STL
+#include <cstdio>
+
+// ROOT
+#include "TSystem.h"
+
+/* Shared by the test macros in tests/. Every check prints PASS or FAIL,
+ * done() exits with 1 if one failed so that scons test fails
+ */
+int nFailed = 0;
+
+void check( bool ok, const char * what ){
+	printf( "%s %s\n", ok ? "PASS" : "FAIL", what );
+	if ( false == ok ) nFailed++;
+}
+
+void done(){
+	gSystem->Exit( nFailed > 0 ? 1 : 0 );
+}
+
+#endif